@@ -0,0 +1,485 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bbb_ioctl.h"
+
+/*
+ * lcd_trace : replays a bus capture of the multi_device module against a model of the HD44780
+ * and reports how well the bus was used.
+ *
+ * The capture is what /sys/kernel/debug/bbb_lcd/capture gives with capture_kb set, taken on the
+ * board and analyzed anywhere. Every panel strobed by a record gets the nibble, so the model
+ * follows each panel's DDRAM, address counter, display shift and nibble phase, and can tell an
+ * instruction that changed nothing from one that did.
+ * Times are those of the capture, a capture of a dry_run module has no real bus timing.
+ */
+
+// panel geometry, the same as NUM_LINES and NUM_CHARS_PER_LINE of the driver
+#define TRACE_ROWS          2
+#define TRACE_COLS          16
+#define TRACE_DDRAM_COLS    40
+#define TRACE_PANELS        32
+
+// HD44780 execution times in ns at 270 kHz, from the datasheet
+#define T_EXEC_NS           37000
+#define T_DATA_NS           41000
+#define T_EXEC_LONG_NS      1520000
+
+#define TRACE_IDLE_GAP_US   5000    // a longer pause between two nibbles is idle, not waiting on the panel
+
+// what the decoded instructions were, one counter each
+enum
+{
+    OP_CLEAR,
+    OP_HOME,
+    OP_ENTRY,
+    OP_DISPLAY,
+    OP_SHIFT,
+    OP_FUNCTION,
+    OP_CGRAM,
+    OP_DDRAM,
+    OP_DATA,
+    OP_READ_BUSY,
+    OP_READ_DATA,
+    OP_COUNT
+};
+
+static const char *const op_name[OP_COUNT] = {
+    "clear display", "return home", "entry mode", "display control", "cursor/display shift",
+    "function set", "set CGRAM address", "set DDRAM address", "write data", "read busy flag", "read data",
+};
+
+struct hd44780
+{
+    int used;
+    int ready;                  // past the power on sequence, the display was turned on. Nothing is redundant before
+    int four_bit;               // 0 until function set with DL = 0, each nibble is a whole instruction then
+    int half;                   // 1 when the high nibble of a byte has been latched
+    unsigned char high;
+    unsigned char ddram[0x80];
+    unsigned char ac;
+    int cgram;                  // the address counter points into CGRAM
+    unsigned int shift;         // DDRAM column shown in the first visible column
+    unsigned char entry, display, function;
+    unsigned long long busy_until;
+};
+
+struct trace_stats
+{
+    unsigned long long records, writes, reads, lost, early;
+    unsigned long long first_ns, last_ns, active_ns, needed_ns;
+    unsigned long long idle_gaps, idle_ns, longest_idle_ns;
+    unsigned long long idle_hist[4];                // up to 10 ms, 100 ms, 1 s, longer
+    unsigned long long ops[OP_COUNT], redundant[OP_COUNT];
+    unsigned long long chars;                       // characters that changed a cell
+};
+
+static struct hd44780 panel[TRACE_PANELS];
+static struct trace_stats st;
+static int verbose;
+static int start_four_bit;      // the capture does not start at power on, the panels are past lcd_initialize()
+
+// a panel the first time a record strobes it, DDRAM is assumed blank
+static void hd_reset(struct hd44780 *hd)
+{
+    memset(hd, 0, sizeof(*hd));
+    memset(hd->ddram, ' ', sizeof(hd->ddram));
+    hd->used = 1;
+    hd->entry = 0x06;
+    if (start_four_bit)
+    {
+        hd->ready = 1;
+        hd->four_bit = 1;
+        hd->function = 0x28;
+        hd->display = 0x0F;
+    }
+    else
+    {
+        hd->function = 0x30;
+        hd->display = 0x08;
+    }
+}
+
+// address counter one step on, the two DDRAM lines are 0x00-0x27 and 0x40-0x67
+static void hd_step(struct hd44780 *hd, int up)
+{
+    if (hd->cgram)
+    {
+        hd->ac = (hd->ac + (up ? 1 : 0x3F)) & 0x3F;
+        return;
+    }
+    if (up)
+        hd->ac = (hd->ac == 0x27) ? 0x40 : (hd->ac == 0x67) ? 0x00 : hd->ac + 1;
+    else
+        hd->ac = (hd->ac == 0x40) ? 0x27 : (hd->ac == 0x00) ? 0x67 : hd->ac - 1;
+}
+
+static void hd_shift(struct hd44780 *hd, int left)
+{
+    // shifting the display left moves the window one DDRAM column to the right
+    hd->shift = (hd->shift + (left ? 1 : TRACE_DDRAM_COLS - 1)) % TRACE_DDRAM_COLS;
+}
+
+static int hd_blank(const struct hd44780 *hd)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(hd->ddram); i++)
+    {
+        if (hd->ddram[i] != ' ')
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * description:		execute one instruction on the model.
+ * @return		1 when it left the panel as it was, the bus time spent on it bought nothing
+ */
+static int hd_instruction(struct hd44780 *hd, unsigned char cmd, int *op, unsigned long long *exec)
+{
+    int same = 0;
+
+    *exec = T_EXEC_NS;
+    if (cmd & 0x80)
+    {
+        *op = OP_DDRAM;
+        same = !hd->cgram && hd->ac == (cmd & 0x7F);
+        hd->ac = cmd & 0x7F;
+        hd->cgram = 0;
+    }
+    else if (cmd & 0x40)
+    {
+        *op = OP_CGRAM;
+        hd->ac = cmd & 0x3F;
+        hd->cgram = 1;
+    }
+    else if (cmd & 0x20)
+    {
+        *op = OP_FUNCTION;
+        same = hd->function == cmd;
+        hd->function = cmd;
+        hd->four_bit = !(cmd & 0x10);
+    }
+    else if (cmd & 0x10)
+    {
+        *op = OP_SHIFT;
+        if (cmd & 0x08)
+            hd_shift(hd, !(cmd & 0x04));
+        else
+            hd_step(hd, cmd & 0x04);
+    }
+    else if (cmd & 0x08)
+    {
+        *op = OP_DISPLAY;
+        same = hd->display == cmd;
+        hd->display = cmd;
+        if (cmd & 0x04)
+        {
+            same &= hd->ready;
+            hd->ready = 1;
+        }
+    }
+    else if (cmd & 0x04)
+    {
+        *op = OP_ENTRY;
+        same = hd->entry == cmd;
+        hd->entry = cmd;
+    }
+    else if (cmd & 0x02)
+    {
+        *op = OP_HOME;
+        *exec = T_EXEC_LONG_NS;
+        same = !hd->cgram && hd->ac == 0 && hd->shift == 0;
+        hd->ac = 0;
+        hd->cgram = 0;
+        hd->shift = 0;
+    }
+    else if (cmd & 0x01)
+    {
+        *op = OP_CLEAR;
+        *exec = T_EXEC_LONG_NS;
+        same = !hd->cgram && hd->ac == 0 && hd->shift == 0 && hd_blank(hd);
+        memset(hd->ddram, ' ', sizeof(hd->ddram));
+        hd->ac = 0;
+        hd->cgram = 0;
+        hd->shift = 0;
+        hd->entry |= 0x02;
+    }
+    else
+    {
+        *op = OP_FUNCTION;  // 0x00 does nothing, counted with the other odd ones
+        same = 1;
+    }
+    return same && hd->ready;
+}
+
+// write one character at the address counter, returns 1 when the cell already held it
+static int hd_data(struct hd44780 *hd, unsigned char c, int *changed)
+{
+    int same = 0;
+
+    *changed = 0;
+    if (!hd->cgram)
+    {
+        same = hd->ddram[hd->ac & 0x7F] == c;
+        *changed = !same;
+        hd->ddram[hd->ac & 0x7F] = c;
+    }
+    hd_step(hd, hd->entry & 0x02);
+    if (hd->entry & 0x01)
+        hd_shift(hd, hd->entry & 0x02);
+    return same && hd->ready;
+}
+
+/*
+ * description:		feed one nibble to a panel. A whole byte is executed after its low nibble, or
+ *			every nibble in 8 bit mode where D3-D0 are not wired and read as 0.
+ * @return		1 when a byte was completed, with *byte holding it
+ */
+static int hd_nibble(struct hd44780 *hd, unsigned char nib, unsigned char *byte)
+{
+    if (!hd->four_bit)
+    {
+        *byte = nib << 4;
+        return 1;
+    }
+    if (!hd->half)
+    {
+        hd->high = nib;
+        hd->half = 1;
+        return 0;
+    }
+    hd->half = 0;
+    *byte = (hd->high << 4) | nib;
+    return 1;
+}
+
+/*
+ * description:		replay one record on every panel it strobed. An operation counts as redundant
+ *			only when it changed none of them, a broadcast that helps one panel is not wasted.
+ */
+static void trace_record(const struct lcd_capture_rec *rec)
+{
+    unsigned long long exec = 0, e;
+    unsigned char byte = 0;
+    int i, op = -1, o, done = 0, same = 1, changed = 0, c;
+
+    for (i = 0; i < TRACE_PANELS; i++)
+    {
+        struct hd44780 *hd = &panel[i];
+
+        if (!(rec->panels & (1u << i)))
+            continue;
+        if (!hd->used)
+            hd_reset(hd);
+        if (!hd_nibble(hd, rec->nibble, &byte))
+            continue;
+        done = 1;
+
+        if (rec->flags & LCD_CAP_READ)
+        {
+            o = (rec->flags & LCD_CAP_RS) ? OP_READ_DATA : OP_READ_BUSY;
+            if (o == OP_READ_DATA)
+                hd_step(hd, hd->entry & 0x02);
+            same = 0;
+            e = 0;
+        }
+        else
+        {
+            // the controller ignores what comes while it is still busy
+            if (rec->ns < hd->busy_until)
+                st.early++;
+            if (rec->flags & LCD_CAP_RS)
+            {
+                o = OP_DATA;
+                e = T_DATA_NS;
+                same &= hd_data(hd, byte, &c);
+                changed |= c;
+            }
+            else
+            {
+                same &= hd_instruction(hd, byte, &o, &e);
+            }
+            hd->busy_until = rec->ns + e;
+        }
+        op = o;
+        if (e > exec)
+            exec = e;
+    }
+    if (!done || op < 0)
+        return;
+
+    st.ops[op]++;
+    if (same && op != OP_READ_BUSY && op != OP_READ_DATA)
+        st.redundant[op]++;
+    else
+        st.needed_ns += exec;
+    st.chars += changed;
+
+    if (verbose)
+        printf("%12.6f  panels %08x  %-20s 0x%02x%s\n", (rec->ns - st.first_ns) / 1e9, rec->panels,
+               op_name[op], byte, (same && op < OP_READ_BUSY) ? "  redundant" : "");
+}
+
+// time between two records, either the bus waiting on the panels or the driver having nothing to send
+static void trace_gap(unsigned long long gap_ns, unsigned long long idle_gap_ns)
+{
+    if (gap_ns <= idle_gap_ns)
+    {
+        st.active_ns += gap_ns;
+        return;
+    }
+    st.idle_gaps++;
+    st.idle_ns += gap_ns;
+    if (gap_ns > st.longest_idle_ns)
+        st.longest_idle_ns = gap_ns;
+    if (gap_ns < 10000000ULL)
+        st.idle_hist[0]++;
+    else if (gap_ns < 100000000ULL)
+        st.idle_hist[1]++;
+    else if (gap_ns < 1000000000ULL)
+        st.idle_hist[2]++;
+    else
+        st.idle_hist[3]++;
+}
+
+static void trace_report(void)
+{
+    unsigned long long span = st.last_ns - st.first_ns, useful = 0, wasted = 0;
+    int i;
+
+    printf("records %llu (%llu writes, %llu reads), %llu lost to the ring\n", st.records, st.writes, st.reads, st.lost);
+    printf("span %.3f s, bus active %.3f s (%.1f %%), idle %.3f s\n", span / 1e9, st.active_ns / 1e9,
+           span ? 100.0 * st.active_ns / span : 0.0, st.idle_ns / 1e9);
+    printf("idle gaps %llu, longest %.3f s, <10 ms %llu, <100 ms %llu, <1 s %llu, longer %llu\n", st.idle_gaps,
+           st.longest_idle_ns / 1e9, st.idle_hist[0], st.idle_hist[1], st.idle_hist[2], st.idle_hist[3]);
+
+    printf("\n%-22s %10s %10s\n", "operation", "count", "redundant");
+    for (i = 0; i < OP_COUNT; i++)
+    {
+        if (st.ops[i] == 0)
+            continue;
+        printf("%-22s %10llu %10llu\n", op_name[i], st.ops[i], st.redundant[i]);
+        if (i < OP_READ_BUSY)
+        {
+            useful += st.ops[i] - st.redundant[i];
+            wasted += st.redundant[i];
+        }
+    }
+    printf("\nredundant %llu of %llu instructions and writes (%.1f %%)\n", wasted, useful + wasted,
+           (useful + wasted) ? 100.0 * wasted / (useful + wasted) : 0.0);
+    printf("the panels needed %.1f ms of the %.1f ms the bus was active (%.1f %%)\n", st.needed_ns / 1e6,
+           st.active_ns / 1e6, st.active_ns ? 100.0 * st.needed_ns / st.active_ns : 0.0);
+    printf("nibbles sent before the panel was ready %llu\n", st.early);
+    printf("characters that changed a cell %llu, %.1f/s of bus activity, %.1f/s over the capture\n", st.chars,
+           st.active_ns ? st.chars / (st.active_ns / 1e9) : 0.0, span ? st.chars / (span / 1e9) : 0.0);
+}
+
+// what each panel shows at the end of the capture
+static void trace_screens(void)
+{
+    unsigned int row, col, addr;
+    int i;
+
+    for (i = 0; i < TRACE_PANELS; i++)
+    {
+        if (!panel[i].used)
+            continue;
+        printf("\npanel %d%s\n", i, (panel[i].display & 0x04) ? "" : " (display off)");
+        for (row = 0; row < TRACE_ROWS; row++)
+        {
+            putchar('|');
+            for (col = 0; col < TRACE_COLS; col++)
+            {
+                addr = row * 0x40 + (panel[i].shift + col) % TRACE_DDRAM_COLS;
+                putchar(panel[i].ddram[addr] >= 0x20 && panel[i].ddram[addr] < 0x7F ? panel[i].ddram[addr] : '.');
+            }
+            printf("|\n");
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    struct lcd_capture_rec rec;
+    unsigned long long idle_gap_ns = TRACE_IDLE_GAP_US * 1000ULL, prev_ns = 0;
+    unsigned short seq = 0;
+    int opt, screens = 0;
+    FILE *fp;
+
+    while ((opt = getopt(argc, argv, "g:v4s")) != -1)
+    {
+        switch (opt)
+        {
+        case 'g':
+            idle_gap_ns = strtoull(optarg, NULL, 0) * 1000ULL;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case '4':
+            start_four_bit = 1;
+            break;
+        case 's':
+            screens = 1;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind + 1 != argc)
+        goto usage;
+
+    fp = fopen(argv[optind], "rb");
+    if (fp == NULL)
+    {
+        perror("fopen() failed");
+        return 1;
+    }
+
+    while (fread(&rec, sizeof(rec), 1, fp) == 1)
+    {
+        if (st.records == 0)
+        {
+            st.first_ns = rec.ns;
+            // the ring already overtook the start of a capture that does not begin with record 0
+            if (rec.seq != 0)
+                start_four_bit = 1;
+        }
+        else
+        {
+            st.lost += (unsigned short)(rec.seq - seq - 1);
+            trace_gap(rec.ns - prev_ns, idle_gap_ns);
+        }
+        seq = rec.seq;
+        prev_ns = rec.ns;
+        st.last_ns = rec.ns;
+        st.records++;
+        if (rec.flags & LCD_CAP_READ)
+            st.reads++;
+        else
+            st.writes++;
+        trace_record(&rec);
+    }
+    fclose(fp);
+
+    if (st.records == 0)
+    {
+        printf("empty capture\n");
+        return 1;
+    }
+    trace_report();
+    if (screens)
+        trace_screens();
+    return 0;
+
+usage:
+    printf("usage: %s [-g idle_gap_us] [-v] [-4] [-s] capture\n", argv[0]);
+    printf("-g  a longer pause between two nibbles is idle, default %d us\n", TRACE_IDLE_GAP_US);
+    printf("-v  print every operation\n");
+    printf("-4  the capture starts with the panels already in four bit mode\n");
+    printf("-s  print what each panel shows at the end\n");
+    return 1;
+}
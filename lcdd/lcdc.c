@@ -0,0 +1,27 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lcdd_proto.h"
+
+// send one update to lcdd from a shell script
+int main(int argc, char *argv[])
+{
+    int sock;
+
+    if (argc != 6)
+    {
+        printf("usage: %s row col prio ttl_seconds text\n", argv[0]);
+        return 1;
+    }
+    sock = lcdd_connect(getenv("LCDD_SOCKET"));
+    if (sock < 0)
+    {
+        perror("lcdd_connect() failed");
+        return 1;
+    }
+    if (lcdd_show(sock, atoi(argv[1]), atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), argv[5]) < 0)
+    {
+        perror("lcdd_show() failed");
+        return 1;
+    }
+    return 0;
+}
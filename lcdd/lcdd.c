@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "liblcd.h"
+#include "lcdd_proto.h"
+
+/*
+ * lcdd : owns the lcd and shows what its clients send over a unix datagram socket.
+ *
+ * Updates are only stored when they arrive. Once per frame the regions are drawn by priority
+ * into the liblcd shadow and flushed, so any number of updates of a region within a frame
+ * cost one flush, and the panel is driven at a steady rate no matter how chatty clients are.
+ * -d takes anything liblcd can write to, a plain file of LCD_PANEL_CELLS bytes works for testing.
+ */
+
+#define LCDD_FRAME_MS       100
+
+struct lcdd_region
+{
+    int used;
+    unsigned int row, col, len;
+    unsigned int prio;
+    unsigned long seq;          // arrival order, newer is drawn on top of equal priority
+    struct timespec expires;    // tv_sec 0 when the region never expires
+    char text[LCDD_MAX_TEXT];
+};
+
+static struct lcdd_region regions[LCDD_MAX_REGIONS];
+static unsigned long seq;
+static volatile sig_atomic_t quit;
+
+static void lcdd_signal(int sig)
+{
+    (void)sig;
+    quit = 1;
+}
+
+static long lcdd_ms_until(const struct timespec *now, const struct timespec *t)
+{
+    return (t->tv_sec - now->tv_sec) * 1000 + (t->tv_nsec - now->tv_nsec) / 1000000;
+}
+
+static void lcdd_add_ms(struct timespec *t, long ms)
+{
+    t->tv_sec += ms / 1000;
+    t->tv_nsec += (ms % 1000) * 1000000;
+    if (t->tv_nsec >= 1000000000)
+    {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000;
+    }
+}
+
+// lower priority first, the older of equal priority first
+static int lcdd_region_below(const struct lcdd_region *a, const struct lcdd_region *b)
+{
+    return a->prio < b->prio || (a->prio == b->prio && a->seq < b->seq);
+}
+
+static int lcdd_expired(const struct lcdd_region *r, const struct timespec *now)
+{
+    return r->expires.tv_sec != 0 && lcdd_ms_until(now, &r->expires) <= 0;
+}
+
+static struct lcdd_region *lcdd_find(unsigned int row, unsigned int col, unsigned int len)
+{
+    struct lcdd_region *r;
+
+    for (r = regions; r < regions + LCDD_MAX_REGIONS; r++)
+    {
+        if (r->used && r->row == row && r->col == col && r->len == len)
+            return r;
+    }
+    return NULL;
+}
+
+/*
+ * slot for an update of region row/col/len at 'prio': its own slot, else a free or expired one.
+ * With the table full the lowest priority region, the oldest of those, is given up, but never for
+ * an update of lower priority than it. NULL when the update is dropped.
+ */
+static struct lcdd_region *lcdd_slot(unsigned int row, unsigned int col, unsigned int len, unsigned int prio,
+                                     const struct timespec *now)
+{
+    struct lcdd_region *r, *victim = NULL;
+
+    r = lcdd_find(row, col, len);
+    if (r != NULL)
+        return r;
+    for (r = regions; r < regions + LCDD_MAX_REGIONS; r++)
+    {
+        if (!r->used || lcdd_expired(r, now))
+            return r;
+        if (victim == NULL || lcdd_region_below(r, victim))
+            victim = r;
+    }
+    if (victim->prio > prio)
+        return NULL;
+    return victim;
+}
+
+// store one update, returns 1 when the panel has to be redrawn
+static int lcdd_update(const struct lcdd_msg *msg, ssize_t size, const struct timespec *now)
+{
+    struct lcdd_region *r;
+
+    if (size < LCDD_MSG_HDR_SIZE || msg->version != LCDD_PROTO_VERSION)
+        return 0;
+    if (msg->row >= LCD_PANEL_ROWS || msg->col >= LCD_PANEL_COLS || msg->len == 0 ||
+        msg->len > LCD_PANEL_COLS - msg->col)
+        return 0;
+
+    if (msg->flags & LCDD_REMOVE)
+    {
+        r = lcdd_find(msg->row, msg->col, msg->len);
+        if (r == NULL)
+            return 0;
+        r->used = 0;
+        return 1;
+    }
+    if (size < LCDD_MSG_HDR_SIZE + msg->len)
+        return 0;
+
+    r = lcdd_slot(msg->row, msg->col, msg->len, msg->prio, now);
+    if (r == NULL)
+        return 0;
+
+    r->used = 1;
+    r->row = msg->row;
+    r->col = msg->col;
+    r->len = msg->len;
+    r->prio = msg->prio;
+    r->seq = ++seq;
+    memcpy(r->text, msg->text, msg->len);
+    r->expires.tv_sec = 0;
+    if (msg->ttl != 0)
+    {
+        r->expires = *now;
+        r->expires.tv_sec += msg->ttl;
+    }
+    return 1;
+}
+
+// drop expired regions, returns 1 if any was dropped
+static int lcdd_expire(const struct timespec *now)
+{
+    struct lcdd_region *r;
+    int changed = 0;
+
+    for (r = regions; r < regions + LCDD_MAX_REGIONS; r++)
+    {
+        if (r->used && lcdd_expired(r, now))
+        {
+            r->used = 0;
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+// draw every region bottom up into the shadow and send the difference to the lcd
+static int lcdd_draw(struct lcd_panel *panel)
+{
+    const struct lcdd_region *order[LCDD_MAX_REGIONS], *tmp;
+    char text[LCDD_MAX_TEXT + 1];
+    int n = 0, i, j;
+
+    for (i = 0; i < LCDD_MAX_REGIONS; i++)
+    {
+        if (regions[i].used)
+            order[n++] = &regions[i];
+    }
+    // insertion sort, there are at most LCDD_MAX_REGIONS of them
+    for (i = 1; i < n; i++)
+    {
+        tmp = order[i];
+        for (j = i; j > 0 && lcdd_region_below(tmp, order[j - 1]); j--)
+            order[j] = order[j - 1];
+        order[j] = tmp;
+    }
+
+    lcd_panel_clear(panel);
+    for (i = 0; i < n; i++)
+    {
+        memcpy(text, order[i]->text, order[i]->len);
+        text[order[i]->len] = '\0';
+        lcd_panel_puts(panel, order[i]->row, order[i]->col, text);
+    }
+    return lcd_panel_flush(panel);
+}
+
+static int lcdd_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    int sock;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dev = LCD_PANEL_DEFAULT_PATH, *path = LCDD_SOCKET_PATH;
+    long frame_ms = LCDD_FRAME_MS, timeout;
+    struct lcd_panel *panel;
+    struct lcdd_msg msg;
+    struct timespec now, next;
+    struct pollfd pfd;
+    ssize_t size;
+    int opt, sock, dirty = 1;
+
+    while ((opt = getopt(argc, argv, "d:s:f:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            dev = optarg;
+            break;
+        case 's':
+            path = optarg;
+            break;
+        case 'f':
+            frame_ms = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-d lcd_device] [-s socket_path] [-f frame_ms]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frame_ms <= 0)
+        frame_ms = LCDD_FRAME_MS;
+
+    panel = lcd_panel_open(dev);
+    if (panel == NULL)
+    {
+        perror("lcd_panel_open() failed");
+        return 1;
+    }
+    sock = lcdd_listen(path);
+    if (sock < 0)
+    {
+        perror("socket bind failed");
+        lcd_panel_close(panel);
+        return 1;
+    }
+
+    signal(SIGINT, lcdd_signal);
+    signal(SIGTERM, lcdd_signal);
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!quit)
+    {
+        // collect updates until the frame is due
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        timeout = lcdd_ms_until(&now, &next);
+        if (timeout > 0)
+        {
+            if (poll(&pfd, 1, timeout) > 0)
+            {
+                while ((size = recv(sock, &msg, sizeof(msg), 0)) > 0)
+                    dirty |= lcdd_update(&msg, size, &now);
+            }
+            continue;
+        }
+
+        dirty |= lcdd_expire(&now);
+        if (dirty && lcdd_draw(panel) < 0)
+            perror("lcd flush failed");
+        dirty = 0;
+
+        // steady frame rate, a late frame does not make the following ones come faster
+        lcdd_add_ms(&next, frame_ms);
+        if (lcdd_ms_until(&now, &next) <= 0)
+        {
+            next = now;
+            lcdd_add_ms(&next, frame_ms);
+        }
+    }
+
+    close(sock);
+    unlink(path);
+    lcd_panel_close(panel);
+    return 0;
+}
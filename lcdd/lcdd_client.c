@@ -0,0 +1,76 @@
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "lcdd_proto.h"
+
+// connected non blocking datagram socket to the daemon, every update is then a single send()
+int lcdd_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    int sock;
+
+    if (path == NULL)
+        path = LCDD_SOCKET_PATH;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static int lcdd_send(int sock, struct lcdd_msg *msg)
+{
+    // a full socket queue means the daemon is behind, the update is dropped rather than waited for
+    if (send(sock, msg, LCDD_MSG_HDR_SIZE + msg->len, 0) < 0)
+        return -1;
+    return 0;
+}
+
+int lcdd_show(int sock, unsigned int row, unsigned int col, unsigned int prio, unsigned int ttl, const char *text)
+{
+    struct lcdd_msg msg;
+
+    memset(&msg, 0, LCDD_MSG_HDR_SIZE);
+    msg.version = LCDD_PROTO_VERSION;
+    msg.prio = prio > UINT8_MAX ? UINT8_MAX : prio;
+    msg.row = row;
+    msg.col = col;
+    msg.ttl = ttl > UINT16_MAX ? UINT16_MAX : ttl;
+    msg.len = strnlen(text, LCDD_MAX_TEXT);
+    if (msg.len == 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(msg.text, text, msg.len);
+    return lcdd_send(sock, &msg);
+}
+
+int lcdd_remove(int sock, unsigned int row, unsigned int col, unsigned int len)
+{
+    struct lcdd_msg msg;
+
+    memset(&msg, 0, LCDD_MSG_HDR_SIZE);
+    msg.version = LCDD_PROTO_VERSION;
+    msg.row = row;
+    msg.col = col;
+    msg.len = len;
+    msg.flags = LCDD_REMOVE;
+    return send(sock, &msg, LCDD_MSG_HDR_SIZE, 0) < 0 ? -1 : 0;
+}
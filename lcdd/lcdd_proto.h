@@ -0,0 +1,37 @@
+#ifndef __LCDD_PROTO
+#define __LCDD_PROTO
+
+#include <stdint.h>
+
+/*
+ * lcdd wire protocol. One update is one datagram on the SOCK_DGRAM unix socket of the daemon:
+ * an 8 byte header followed by 'len' bytes of text, no terminating NULL.
+ * The daemon keys updates by row/col/len, a newer update of the same region replaces the older one.
+ */
+#define LCDD_SOCKET_PATH    "/run/lcdd.sock"
+#define LCDD_PROTO_VERSION  1
+#define LCDD_MAX_TEXT       16  // one row of the panel
+#define LCDD_MAX_REGIONS    32  // regions the daemon keeps, a full table gives up its lowest priority one
+
+struct lcdd_msg
+{
+    uint8_t version;    // LCDD_PROTO_VERSION
+    uint8_t prio;       // higher is drawn on top
+    uint8_t row;
+    uint8_t col;
+    uint8_t len;        // bytes of text, the width of the region
+    uint8_t flags;      // LCDD_REMOVE
+    uint16_t ttl;       // seconds until the region is dropped, 0 keeps it
+    char text[LCDD_MAX_TEXT];
+};
+
+#define LCDD_MSG_HDR_SIZE   8
+
+#define LCDD_REMOVE         0x01    // drop the region, no text follows
+
+// client side, lcdd_client.c
+int lcdd_connect(const char *path);
+int lcdd_show(int sock, unsigned int row, unsigned int col, unsigned int prio, unsigned int ttl, const char *text);
+int lcdd_remove(int sock, unsigned int row, unsigned int col, unsigned int len);
+
+#endif
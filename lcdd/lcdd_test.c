@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "lcdd_proto.h"
+
+/*
+ * lcdd_test : runs the lcdd given as argument on a plain file standing in for the panel and
+ * drives it over its socket with the client library, checking what ends up in the file.
+ * Each update is given a few frames to reach the file before the panel is read back.
+ */
+
+#define TEST_FRAME_MS   10
+#define TEST_SETTLE_MS  (10 * TEST_FRAME_MS)
+#define TEST_ROWS       2
+#define TEST_COLS       16
+#define TEST_CELLS      (TEST_ROWS * TEST_COLS)
+
+static char dir[] = "/tmp/lcdd_test.XXXXXX";
+static char panel_path[64], sock_path[64];
+static pid_t daemon_pid;
+static int sock = -1;
+static int failed;
+
+static void test_sleep_ms(long ms)
+{
+    struct timespec t = {ms / 1000, (ms % 1000) * 1000000};
+
+    while (nanosleep(&t, &t) < 0 && errno == EINTR)
+        ;
+}
+
+// the daemon drops updates that do not fit its socket queue, a test waits for room instead
+static void test_show(unsigned int row, unsigned int col, unsigned int prio, const char *text)
+{
+    while (lcdd_show(sock, row, col, prio, 0, text) < 0)
+    {
+        if (errno != EAGAIN)
+        {
+            perror("lcdd_show() failed");
+            exit(1);
+        }
+        test_sleep_ms(1);
+    }
+}
+
+static void test_remove(unsigned int row, unsigned int col, unsigned int len)
+{
+    while (lcdd_remove(sock, row, col, len) < 0)
+    {
+        if (errno != EAGAIN)
+        {
+            perror("lcdd_remove() failed");
+            exit(1);
+        }
+        test_sleep_ms(1);
+    }
+}
+
+// wait for the daemon to draw what was sent, then compare the panel with 'row0' and 'row1'
+static void test_expect(const char *name, const char *row0, const char *row1)
+{
+    char want[TEST_CELLS], got[TEST_CELLS];
+    int fd;
+
+    test_sleep_ms(TEST_SETTLE_MS);
+    memset(want, ' ', sizeof(want));
+    memcpy(want, row0, strlen(row0));
+    memcpy(want + TEST_COLS, row1, strlen(row1));
+
+    fd = open(panel_path, O_RDONLY);
+    if (fd < 0 || pread(fd, got, sizeof(got), 0) != sizeof(got))
+    {
+        perror(panel_path);
+        exit(1);
+    }
+    close(fd);
+
+    if (memcmp(want, got, sizeof(got)) == 0)
+    {
+        printf("ok   %s\n", name);
+        return;
+    }
+    printf("FAIL %s\n     want [%.16s][%.16s]\n     got  [%.16s][%.16s]\n", name,
+           want, want + TEST_COLS, got, got + TEST_COLS);
+    failed = 1;
+}
+
+// a blank panel file and the daemon on it, returns once its socket is there
+static void test_start(const char *lcdd)
+{
+    char frame[16];
+    struct stat st;
+    int fd, i;
+
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp() failed");
+        exit(1);
+    }
+    snprintf(panel_path, sizeof(panel_path), "%s/panel", dir);
+    snprintf(sock_path, sizeof(sock_path), "%s/lcdd.sock", dir);
+    snprintf(frame, sizeof(frame), "%d", TEST_FRAME_MS);
+
+    fd = open(panel_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+    {
+        perror(panel_path);
+        exit(1);
+    }
+    for (i = 0; i < TEST_CELLS; i++)
+    {
+        if (write(fd, " ", 1) != 1)
+        {
+            perror(panel_path);
+            exit(1);
+        }
+    }
+    close(fd);
+
+    daemon_pid = fork();
+    if (daemon_pid == 0)
+    {
+        execl(lcdd, lcdd, "-d", panel_path, "-s", sock_path, "-f", frame, (char *)NULL);
+        perror("execl() failed");
+        _exit(1);
+    }
+    for (i = 0; i < 100 && stat(sock_path, &st) < 0; i++)
+        test_sleep_ms(TEST_FRAME_MS);
+
+    sock = lcdd_connect(sock_path);
+    if (sock < 0)
+    {
+        perror("lcdd_connect() failed");
+        kill(daemon_pid, SIGTERM);
+        exit(1);
+    }
+}
+
+static void test_stop(void)
+{
+    int status;
+
+    close(sock);
+    kill(daemon_pid, SIGTERM);
+    waitpid(daemon_pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        printf("FAIL lcdd did not exit cleanly\n");
+        failed = 1;
+    }
+    unlink(panel_path);
+    rmdir(dir);
+}
+
+// the higher priority is drawn on top, a remove uncovers what is below
+static void test_prio(void)
+{
+    test_show(0, 0, 1, "hello");
+    test_expect("show", "hello", "");
+
+    test_show(0, 1, 2, "XY");
+    test_expect("higher prio on top", "hXYlo", "");
+
+    test_show(0, 3, 0, "zzzz");
+    test_expect("lower prio below", "hXYlozz", "");
+
+    test_remove(0, 1, 2);
+    test_expect("remove", "hellozz", "");
+
+    test_remove(0, 0, 5);
+    test_remove(0, 3, 4);
+    test_expect("remove all", "", "");
+}
+
+/*
+ * fill the table with one region per cell, all at priority 5 except the newest one, then send
+ * regions past the table. The newest one goes first as it has the lowest priority, then the oldest
+ * of priority 5. An update of lower priority than everything in the table is dropped.
+ */
+static void test_evict(void)
+{
+    char text[2] = "a";
+    unsigned int row, col;
+
+    for (row = TEST_ROWS; row-- > 0;)
+    {
+        for (col = 0; col < TEST_COLS; col++)
+        {
+            text[0] = 'a' + col;
+            if (row == 0 && col == TEST_COLS - 1)
+                test_show(row, col, 1, "!");
+            else
+                test_show(row, col, 5, text);
+        }
+    }
+    test_expect("full table", "abcdefghijklmno!", "abcdefghijklmnop");
+
+    test_show(0, 0, 0, "--");
+    test_expect("lower prio is dropped", "abcdefghijklmno!", "abcdefghijklmnop");
+
+    test_show(0, 0, 9, "##");
+    test_expect("lowest prio is evicted", "##cdefghijklmno", "abcdefghijklmnop");
+
+    test_show(0, 2, 9, "##");
+    test_expect("oldest of equal prio is evicted", "####efghijklmno", " bcdefghijklmnop");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        printf("usage: %s path_to_lcdd\n", argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    test_start(argv[1]);
+    test_prio();
+    test_evict();
+    test_stop();
+
+    printf("%s\n", failed ? "FAILED" : "passed");
+    return failed;
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "liblcd.h"
+
+struct lcd_panel
+{
+    int fd;
+    int whole_screen;               // driver has no file offset, every write() redraws the lcd
+    char cells[LCD_PANEL_CELLS];    // what the application wants on the panel
+    char shown[LCD_PANEL_CELLS];    // what the driver was given last
+};
+
+struct lcd_panel *lcd_panel_open(const char *path)
+{
+    struct lcd_panel *panel;
+    ssize_t ret;
+
+    panel = malloc(sizeof(*panel));
+    if (panel == NULL)
+        return NULL;
+
+    panel->fd = open(path ? path : LCD_PANEL_DEFAULT_PATH, O_RDWR);
+    if (panel->fd < 0)
+    {
+        free(panel);
+        return NULL;
+    }
+    memset(panel->cells, ' ', LCD_PANEL_CELLS);
+
+    // drivers that address cells by file offset can be seeked, the older ones can't
+    panel->whole_screen = (lseek(panel->fd, 0, SEEK_SET) < 0);
+    if (panel->whole_screen)
+    {
+        // nothing to read back, the first flush draws the whole screen
+        memset(panel->shown, 0, LCD_PANEL_CELLS);
+        return panel;
+    }
+
+    ret = pread(panel->fd, panel->cells, LCD_PANEL_CELLS, 0);
+    if (ret < 0)
+    {
+        close(panel->fd);
+        free(panel);
+        return NULL;
+    }
+    memcpy(panel->shown, panel->cells, LCD_PANEL_CELLS);
+    return panel;
+}
+
+int lcd_panel_close(struct lcd_panel *panel)
+{
+    int ret;
+
+    if (panel == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    ret = lcd_panel_flush(panel);
+    close(panel->fd);
+    free(panel);
+    return ret < 0 ? -1 : 0;
+}
+
+unsigned int lcd_panel_rows(const struct lcd_panel *panel)
+{
+    (void)panel;    // every panel has the same geometry
+    return LCD_PANEL_ROWS;
+}
+
+unsigned int lcd_panel_cols(const struct lcd_panel *panel)
+{
+    (void)panel;    // every panel has the same geometry
+    return LCD_PANEL_COLS;
+}
+
+int lcd_panel_puts(struct lcd_panel *panel, unsigned int row, unsigned int col, const char *s)
+{
+    size_t len;
+
+    if (panel == NULL || s == NULL || row >= LCD_PANEL_ROWS || col >= LCD_PANEL_COLS)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    len = strnlen(s, LCD_PANEL_COLS - col);
+    memcpy(panel->cells + row * LCD_PANEL_COLS + col, s, len);
+    return len;
+}
+
+int lcd_panel_set_glyph(struct lcd_panel *panel, unsigned int row, unsigned int col, unsigned char glyph)
+{
+    if (panel == NULL || row >= LCD_PANEL_ROWS || col >= LCD_PANEL_COLS)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    panel->cells[row * LCD_PANEL_COLS + col] = glyph;
+    return 0;
+}
+
+void lcd_panel_clear(struct lcd_panel *panel)
+{
+    memset(panel->cells, ' ', LCD_PANEL_CELLS);
+}
+
+// older drivers clear the lcd and print the string, trailing blanks need not be sent
+static int lcd_panel_flush_whole(struct lcd_panel *panel)
+{
+    size_t len = LCD_PANEL_CELLS;
+    ssize_t ret;
+
+    if (memcmp(panel->cells, panel->shown, LCD_PANEL_CELLS) == 0)
+        return 0;
+    while (len > 0 && panel->cells[len - 1] == ' ')
+        len--;
+
+    // a write() of 0 bytes would not reach the driver, a single blank clears it as well
+    ret = write(panel->fd, panel->cells, len ? len : 1);
+    if (ret < 0)
+        return -1;
+    memcpy(panel->shown, panel->cells, LCD_PANEL_CELLS);
+    return ret;
+}
+
+int lcd_panel_flush(struct lcd_panel *panel)
+{
+    unsigned int first, last;
+    ssize_t ret;
+
+    if (panel == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (panel->whole_screen)
+        return lcd_panel_flush_whole(panel);
+
+    for (first = 0; first < LCD_PANEL_CELLS && panel->cells[first] == panel->shown[first]; first++)
+        ;
+    if (first == LCD_PANEL_CELLS)
+        return 0;
+    for (last = LCD_PANEL_CELLS - 1; panel->cells[last] == panel->shown[last]; last--)
+        ;
+
+    /*
+     * one pwrite() from the first to the last changed cell. The unchanged cells in between cost
+     * a few bytes of copy, the driver compares against what the lcd holds and does not send them
+     * on the bus again, so one syscall always beats a syscall per changed run.
+     */
+    ret = pwrite(panel->fd, panel->cells + first, last - first + 1, first);
+    if (ret < 0)
+        return -1;
+    memcpy(panel->shown + first, panel->cells + first, ret);
+    return ret;
+}
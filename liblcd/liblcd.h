@@ -0,0 +1,43 @@
+#ifndef __LIBLCD
+#define __LIBLCD
+
+/*
+ * liblcd : userspace client of the bbb_lcd driver.
+ *
+ * Text is put into a shadow of the screen kept in the process, nothing reaches the driver
+ * until lcd_panel_flush(). A flush sends only the cells that changed since the last one,
+ * as a single pwrite() covering all of them, so drawing a whole screen costs one syscall.
+ * Driver builds without a file offset (older single_device/multi_device modules, which
+ * redraw the whole lcd on every write()) get the whole shadow in one write() instead.
+ *
+ * Every function returns 0 (or the documented value) on success and -1 with errno set on failure.
+ */
+
+#define LCD_PANEL_DEFAULT_PATH  "/dev/bbb_lcd0"
+
+// panel geometry, the same as NUM_LINES and NUM_CHARS_PER_LINE of the driver
+#define LCD_PANEL_ROWS  2
+#define LCD_PANEL_COLS  16
+#define LCD_PANEL_CELLS (LCD_PANEL_ROWS * LCD_PANEL_COLS)
+
+struct lcd_panel;
+
+// open the panel at 'path' (LCD_PANEL_DEFAULT_PATH when NULL), the shadow starts with what the panel shows
+struct lcd_panel *lcd_panel_open(const char *path);
+// flush what is left and close the panel
+int lcd_panel_close(struct lcd_panel *panel);
+
+unsigned int lcd_panel_rows(const struct lcd_panel *panel);
+unsigned int lcd_panel_cols(const struct lcd_panel *panel);
+
+// put 's' at row/col, text past the end of the row is clipped. Returns the number of cells written.
+int lcd_panel_puts(struct lcd_panel *panel, unsigned int row, unsigned int col, const char *s);
+// put one character code, e.g. a CGRAM glyph 0..7, into the cell at row/col
+int lcd_panel_set_glyph(struct lcd_panel *panel, unsigned int row, unsigned int col, unsigned char glyph);
+// blank the whole shadow
+void lcd_panel_clear(struct lcd_panel *panel);
+
+// send the changed cells to the driver. Returns the number of bytes handed to the driver.
+int lcd_panel_flush(struct lcd_panel *panel);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef __BBB_GPIO_REGS
+#define __BBB_GPIO_REGS
+
+/*
+ * AM335x GPIO module registers used by the memory-mapped lcd backend.
+ * Linux gpio number n lives in bank (n / 32) at bit (n % 32).
+ */
+#define GPIO0_BASE          0x44E07000
+#define GPIO1_BASE          0x4804C000
+#define GPIO2_BASE          0x481AC000
+#define GPIO_BANK_SIZE      0x1000
+
+#define GPIO_CLEARDATAOUT   0x190
+#define GPIO_SETDATAOUT     0x194
+
+#define LCD_GPIO_BANKS      3   // lcd pins only use bank 0, 1 and 2
+
+#define LCD_GPIO_BANK(pin)  ((pin) / 32)
+#define LCD_GPIO_BIT(pin)   (1u << ((pin) % 32))
+
+// bit of 'pin' inside 'bank' if 'pin' belongs to that bank, else 0
+#define LCD_PIN_MASK(pin, bank) \
+    ((LCD_GPIO_BANK(pin) == (bank)) ? LCD_GPIO_BIT(pin) : 0u)
+
+// bits of 'bank' that have to be driven high for the 4 bit value 'nib' on D7..D4
+#define LCD_NIB_SET(nib, bank)                              \
+    ((((nib) & 0x1) ? LCD_PIN_MASK(LCD_D4, bank) : 0u) |    \
+     (((nib) & 0x2) ? LCD_PIN_MASK(LCD_D5, bank) : 0u) |    \
+     (((nib) & 0x4) ? LCD_PIN_MASK(LCD_D6, bank) : 0u) |    \
+     (((nib) & 0x8) ? LCD_PIN_MASK(LCD_D7, bank) : 0u))
+
+// bits of 'bank' that have to be driven low for the 4 bit value 'nib' on D7..D4
+#define LCD_NIB_CLR(nib, bank)  LCD_NIB_SET((~(nib)) & 0xF, bank)
+
+struct lcd_bank_mask
+{
+    unsigned int set;   // written to GPIO_SETDATAOUT
+    unsigned int clr;   // written to GPIO_CLEARDATAOUT
+};
+
+struct lcd_byte_mask
+{
+    struct lcd_bank_mask nib[2][LCD_GPIO_BANKS];   // [0] upper nibble, [1] lower nibble
+};
+
+#define LCD_NIB_MASKS(nib)                                      \
+    {                                                           \
+        {LCD_NIB_SET(nib, 0), LCD_NIB_CLR(nib, 0)},             \
+        {LCD_NIB_SET(nib, 1), LCD_NIB_CLR(nib, 1)},             \
+        {LCD_NIB_SET(nib, 2), LCD_NIB_CLR(nib, 2)}              \
+    }
+
+#define LCD_BYTE_MASK(b)        {{LCD_NIB_MASKS(((b) >> 4) & 0xF), LCD_NIB_MASKS((b) & 0xF)}}
+#define LCD_BYTE_MASK_4(b)      LCD_BYTE_MASK(b), LCD_BYTE_MASK((b) + 1), LCD_BYTE_MASK((b) + 2), LCD_BYTE_MASK((b) + 3)
+#define LCD_BYTE_MASK_16(b)     LCD_BYTE_MASK_4(b), LCD_BYTE_MASK_4((b) + 4), LCD_BYTE_MASK_4((b) + 8), LCD_BYTE_MASK_4((b) + 12)
+#define LCD_BYTE_MASK_64(b)     LCD_BYTE_MASK_16(b), LCD_BYTE_MASK_16((b) + 16), LCD_BYTE_MASK_16((b) + 32), LCD_BYTE_MASK_16((b) + 48)
+
+/*
+ * per byte set/clear masks for every bank, generated by the compiler.
+ * lcd_byte_mask[c].nib[0] puts the upper nibble of c on D7..D4, nib[1] the lower one.
+ */
+static const struct lcd_byte_mask lcd_byte_mask[256] = {
+    LCD_BYTE_MASK_64(0),
+    LCD_BYTE_MASK_64(64),
+    LCD_BYTE_MASK_64(128),
+    LCD_BYTE_MASK_64(192)
+};
+
+#endif
@@ -5,14 +5,155 @@
 
 #define BUF_SIZE    32
 
+// what the panel shows, LCD_GET_SNAPSHOT
+struct lcd_snapshot{
+    unsigned int seq;       // changes whenever the cells change
+    char cells[BUF_SIZE];   // row by row, NUM_CHARS_PER_LINE cells per row
+};
+
+// flush progress, LCD_GET_SEQ. A frame submitted as n is on the panel once shown reaches n.
+struct lcd_seq{
+    unsigned int submitted;
+    unsigned int shown;
+};
+
+// rectangle of cells leased by LCD_SET_REGION, width or height 0 gives the lease back
+struct lcd_region{
+    unsigned int row;
+    unsigned int col;
+    unsigned int width;
+    unsigned int height;
+};
+
+// LCD_ADD_WIDGET, text the driver refreshes by itself every widget_ms
+#define LCD_WIDGET_PATH     64
+struct lcd_widget_req{
+    struct lcd_region win;
+    int type;                       // LCD_WIDGET_*
+    char path[LCD_WIDGET_PATH];     // LCD_WIDGET_FILE, a file under /sys or /proc
+};
+
+// bus traffic of all panels since the module was loaded, LCD_GET_BUS_STATS
+struct lcd_bus_stats{
+    unsigned long long cmd_nibbles;     // nibbles sent with RS low
+    unsigned long long data_nibbles;    // nibbles sent with RS high, two per character
+    unsigned long long bus_us;          // time the driver spends on the bus, from the delays it uses
+    unsigned long long repaired_cells;  // cells the scrubber read back wrong and rewrote
+    unsigned long long resyncs;         // panels the scrubber found out of nibble phase
+};
+
+// busy time of each instruction class of a panel as measured, LCD_CALIBRATE. 0 until the panel is calibrated
+struct lcd_timing{
+    unsigned int cmd_us;    // set address and the other short instructions, 37 us on the datasheet
+    unsigned int data_us;   // writing a character, 41 us on the datasheet
+    unsigned int home_us;   // return home and clear display, 1.52 ms on the datasheet
+};
+
+// one nibble on the bus, the records of /sys/kernel/debug/bbb_lcd/capture with capture_kb set
+struct lcd_capture_rec{
+    unsigned long long ns;      // ktime_get_ns() when the nibble was strobed
+    unsigned int panels;        // bit per minor whose EN line was strobed, minors 0 to 31
+    unsigned short seq;         // counts the records, a jump means the ring overtook the reader
+    unsigned char flags;        // LCD_CAP_*
+    unsigned char nibble;       // D7 to D4 in bit 3 to bit 0
+};
+#define LCD_CAP_RS      0x01    // RS high, data rather than instruction
+#define LCD_CAP_READ    0x02    // RW high, nibble is what the panel drove
+
+// one step of an animation, LCD_SET_ANIMATION
+struct lcd_anim_frame{
+    unsigned int ms;        // how long the step stays, counted from when it was due
+    unsigned int first;     // cells first to first + len - 1 of the window get cells[0] onwards,
+    unsigned int len;       // len 0 only waits
+    char cells[BUF_SIZE];
+};
+
+// LCD_SET_ANIMATION, nframes 0 stops the animation and leaves its last step on the screen
+#define LCD_ANIM_MAX_FRAMES 64
+struct lcd_anim{
+    unsigned int nframes;
+    unsigned int loop;              // 1 starts over after the last step, 0 stops on it
+    struct lcd_anim_frame *frames;
+};
+
+/*
+ * io_uring passthrough, IORING_OP_URING_CMD on an open lcd file. sqe->cmd_op is one of the
+ * LCD_URING_* below and the command area of the sqe holds a struct lcd_uring_op. The cqe is
+ * posted once the panel shows the result, cqe->res is the number of cells written or an error.
+ */
+struct lcd_uring_op{
+    unsigned int offset;            // LCD_URING_WRITE, first cell of the window. LCD_URING_GLYPH, the glyph
+    unsigned int len;               // LCD_URING_WRITE, cells to write. LCD_URING_GLYPH, LCD_GLYPH_ROWS
+    unsigned long long addr;        // user buffer with the text or the glyph rows
+};
+
+#define LCD_URING_WRITE     1   // cells offset to offset + len - 1 of the window
+#define LCD_URING_CLEAR     2   // blank the screen
+#define LCD_URING_SYNC      3   // completes once everything submitted before is shown
+#define LCD_URING_GLYPH     4   // load user character offset, shown by cells holding that code
+
+#define LCD_GLYPHS          8   // user characters 0-7 of the 5x8 font
+#define LCD_GLYPH_ROWS      8   // rows top to bottom, the low 5 bits are the pixels left to right
+
 #define LCD_CLEAR_IOCTL _IO('x',1)
 #define LCD_SHIFT_LEFT  _IOW('x',2,int)  //18
 #define LCD_SHIFT_RIGHT _IOW('x',3,int)  //1C
+#define LCD_SET_MODE    _IOW('x',4,int)
+#define LCD_SET_PAGE_FLIP _IOW('x',5,int)
+#define LCD_GET_SCREEN  _IOR('x',6,int)    // id of the virtual screen of this file
+#define LCD_SHOW_SCREEN _IOW('x',7,int)    // make screen <id> the active one
+#define LCD_SET_POLICY  _IOW('x',8,int)
+#define LCD_SET_PRIORITY _IOW('x',9,int)   // priority of the screen of this file
+#define LCD_SET_REGION  _IOW('x',10,struct lcd_region)
+#define LCD_GET_SNAPSHOT _IOR('x',11,struct lcd_snapshot)
+#define LCD_GET_SEQ     _IOR('x',12,struct lcd_seq)
+#define LCD_SET_EVENTFD _IOW('x',13,int)   // eventfd signalled per frame shown, -1 drops it
+#define LCD_ADD_WIDGET  _IOW('x',14,struct lcd_widget_req) // returns the widget id
+#define LCD_DEL_WIDGET  _IOW('x',15,int)
+#define LCD_GET_BUS_STATS _IOR('x',16,struct lcd_bus_stats)
+#define LCD_SET_MIRROR  _IOW('x',17,int)    // mirror group of the panel, 0 for none
+#define LCD_SET_ANIMATION _IOW('x',18,struct lcd_anim)
+#define LCD_SET_TTL     _IOW('x',19,int)   // ms what this file writes matters for, 0 for ever
+#define LCD_CALIBRATE   _IOR('x',20,struct lcd_timing)   // needs rw_wired
+
+// modes for LCD_SET_MODE
+#define LCD_MODE_CELLS      0   // file offset addresses a cell
+#define LCD_MODE_TERMINAL   1   // byte stream with VT100 cursor/erase sequences
+#define LCD_MODE_PAGING     2   // a write is one message, shown a page at a time every page_ms
+
+// widget types for LCD_ADD_WIDGET
+#define LCD_WIDGET_CLOCK    0   // hh:mm:ss, local time
+#define LCD_WIDGET_UPTIME   1
+#define LCD_WIDGET_LOADAVG  2   // 1 minute load average
+#define LCD_WIDGET_FILE     3   // first line of 'path'
+
+// how the active screen is chosen, LCD_SET_POLICY
+#define LCD_SELECT_LATEST       0   // screen written last
+#define LCD_SELECT_MANUAL       1   // only LCD_SHOW_SCREEN switches
+#define LCD_SELECT_ROUND_ROBIN  2   // next screen every rotate_ms
+#define LCD_SELECT_PRIORITY     3   // highest LCD_SET_PRIORITY, newest on a tie
 
 #define LCD_CLEAR       0
 #define LCD_WRITE       1
 #define SHIFT_LEFT  2
 #define SHIFT_RIGHT 3
+#define LCD_WRITE_AT    4
+#define SET_MODE        5
+#define PAGE_FLIP       6
+#define SET_POLICY      7
+#define SHOW_SCREEN     8
+#define SET_REGION      9
+#define GET_SNAPSHOT    10
+#define SYNC_WRITE      11
+#define ADD_WIDGET      12
+#define DEL_WIDGET      13
+#define BUS_STATS       14
+#define PAGE_WRITE      15
+#define SET_MIRROR      16
+#define ANIMATION       17
+#define WRITE_ROWS      18
+#define TTL_WRITE       19
+#define CALIBRATE       20
 
 
 #endif
\ No newline at end of file
@@ -1,42 +1,184 @@
 #ifndef __BBB_LCD
 #define __BBB_LCD
- 
-#define BV(n)       (1 << (n))
-
-#define LCD_RS   67  // P8_8
-#define LCD_RW   68  // P8_10 GND
-#define LCD_EN   44  // P8_12
-#define LCD_D4   26  // P8_14
-#define LCD_D5   46  // P8_16
-#define LCD_D6   65  // P8_18
-#define LCD_D7   61  // P8_26
-
-#define LCD_LINE_NUM_ONE    1
-#define LCD_LINE_NUM_TWO    2
-#define LCD_LINE1_ADD 		0x80
-#define LCD_LINE2_ADD 		0xC0
-#define NUM_CHARS_PER_LINE  16
-
-#define LCD_CMD		    0
-#define LCD_DATA	    1
-#define FIFO_SIZE       32
+
+// driver prototypes, userspace includes bbb_lcd_hw.h and bbb_ioctl.h only
+#include <linux/types.h>  // __poll_t
+
+#include "bbb_lcd_hw.h"  // wiring and geometry, shared with lcd_test
+
+struct lcd;
 
 static int lcd_all_pin_init(void);
 static void lcd_all_pin_free(void);
+static int lcd_mmio_init(void);
+static void lcd_mmio_free(void);
+static void lcd_bus_sleep(unsigned int min_us, unsigned int max_us);
+static void lcd_bus_udelay(unsigned int us);
+static void lcd_write_nibble(char byte, int half, int rs);
 static void lcd_instruction(char command);
 static void lcd_data(char data);
 static void lcd_initialize(void);
-static void lcd_print(struct kfifo *msg, unsigned int lineNumber);
-static void lcd_setLinePosition(unsigned int line);
+static unsigned int lcd_flush_page(struct lcd *pdev, unsigned int page, unsigned int first, unsigned int last);
+static void lcd_flush(struct lcd *pdev, unsigned int first, unsigned int last);
+static void lcd_present(struct lcd *pdev, unsigned int page);
+static int lcd_blank_is_cheaper(struct lcd *pdev);
+static void lcd_blank(struct lcd *pdev);
+static void lcd_setCursor(unsigned int row, unsigned int col);
+static void lcd_load_glyphs(struct lcd *pdev);
+
+#define LCD_MAX_EN          8   // panels that can have an EN line of their own, lcd_en=
+static int lcd_en_pin_init(void);
+static void lcd_en_pin_free(void);
+static int lcd_en_own(int i);
+static void lcd_bus_select(struct lcd *pdev, int group);
+static struct lcd *lcd_mirror_leader(struct lcd *pdev);
+static int lcd_set_mirror(struct lcd *pdev, unsigned int group);
+static void lcd_mirror_prepare(struct lcd *pdev);
+static void lcd_mirror_update(struct lcd *pdev);
+static void lcd_mirror_shown(struct lcd *pdev, const char *frame);
+static int lcd_mirror_holds(unsigned int row, unsigned int col, char c);
+
+#define LCD_SCRUB_CELLS     4   // DDRAM cells read back per scrub_ms
+static int lcd_rw_pin_init(void);
+static unsigned char lcd_read_byte(int rs);
+static void lcd_resync(void);
+static void lcd_scrub_work(struct work_struct *work);
+
+#define LCD_BUSY_DEFAULT_US     2000    // wait of a panel that was not calibrated
+#define LCD_FAST_CMD_US         40      // display shift of a panel that was not calibrated, 37 us on the datasheet
+#define LCD_BUSY_TIMEOUT_US     10000   // a panel busy for longer does not answer
+#define LCD_CALIBRATE_RUNS      8       // each instruction class is measured this often, the longest counts
+#define LCD_OVERSHOOT_PROBE_US  100     // sleep the overshoot is measured with
+struct lcd_timing;
+static void lcd_bus_wait(unsigned int us);
+static unsigned int lcd_timing_us(unsigned int measured);
+static void lcd_bus_timing(void);
+static void lcd_bus_select_one(unsigned int minor);
+static int lcd_en_shared(unsigned int minor);
+static int lcd_busy_us(void);
+static unsigned int lcd_sleep_overshoot(void);
+static int lcd_calibrate(unsigned int minor, char c);
+static int lcd_recalibrate(struct lcd *pdev, struct lcd_timing *t);
+
+#define LCD_CAPTURE_CHUNK   256     // records copied out of the capture ring per read() step
+static int lcd_capture_init(void);
+static void lcd_capture_free(void);
+static void lcd_capture(unsigned char nibble, int flags);
+static ssize_t lcd_capture_read(struct file *pfile, char *ubuf, size_t size, loff_t *poffset);
+
+struct lcd_screen;
+struct lcd_region;
+static int lcd_select_screen(struct lcd *pdev);
+static void lcd_screen_changed(struct lcd_screen *scr);
+static void lcd_screen_submit(struct lcd_screen *scr);
+static int lcd_screen_live(struct lcd_screen *scr);
+static struct lcd_screen *lcd_newest_screen(struct lcd *pdev);
+static void lcd_expire_work(struct work_struct *work);
+static void lcd_screen_clear(struct lcd_screen *scr);
+static int lcd_show_screen(struct lcd *pdev, unsigned int id);
+static int lcd_set_policy(struct lcd *pdev, int policy);
+static struct lcd_screen *lcd_next_screen(struct lcd *pdev, struct lcd_screen *scr);
+static int lcd_set_region(struct lcd_screen *scr, const struct lcd_region *region);
+static void lcd_rotate_work(struct work_struct *work);
+static void lcd_frame_shown(struct lcd *pdev);
+static unsigned int lcd_queue_flush(struct lcd *pdev);
+static int lcd_seq_shown(struct lcd *pdev, unsigned int seq);
+static int lcd_set_eventfd(struct lcd_screen *scr, int fd);
+struct io_uring_cmd;
+#ifdef LCD_URING   // set by lcd_multi.c on kernels with the io_uring command API
+static int lcd_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags);
+static int lcd_uring_cancel(struct io_uring_cmd *cmd, unsigned int issue_flags);
+struct lcd_uring_op;
+static int lcd_uring_screen(struct lcd_screen *scr, unsigned int cmd_op, const struct lcd_uring_op *op,
+                            unsigned int issue_flags);
+static int lcd_uring_glyph(struct lcd *pdev, const struct lcd_uring_op *op, unsigned int issue_flags);
+static void lcd_uring_done(struct io_uring_cmd *cmd, unsigned int issue_flags);
+#endif
+static void lcd_uring_shown(struct lcd *pdev);
+
+struct lcd_widget;
+struct lcd_widget_req;
+struct path;
+static int lcd_region_valid(const struct lcd_region *win);
+static int lcd_region_overlap(const struct lcd_region *a, const struct lcd_region *b);
+static int lcd_region_busy(struct lcd *pdev, const struct lcd_region *win, struct lcd_screen *self);
+static int lcd_widget_render(struct lcd_widget *w);
+static void lcd_widget_read(const struct path *file, char *text);
+static void lcd_widget_work(struct work_struct *work);
+static void lcd_widget_render_work(struct work_struct *work);
+static int lcd_add_widget(struct lcd *pdev, struct lcd_widget_req *req);
+static int lcd_del_widget(struct lcd *pdev, unsigned int id);
+static void lcd_widget_free(struct lcd_widget *w);
+static void lcd_widgets_free(struct lcd *pdev);
+
+#define LCD_PAGE_MAX    1024    // longest LCD_MODE_PAGING message
+static char *lcd_page_layout(const char *text, size_t len, const struct lcd_region *win, unsigned int *npages);
+static void lcd_page_show(struct lcd_screen *scr, unsigned int page);
+static void lcd_page_drop(struct lcd_screen *scr);
+static ssize_t lcd_page_write(struct lcd_screen *scr, const char *ubuf, size_t size);
+static void lcd_page_set(struct lcd_screen *scr, char *pages, unsigned int npages);
+static void lcd_page_work(struct work_struct *work);
+
+struct lcd_anim;
+static void lcd_anim_show(struct lcd_screen *scr, unsigned int pos);
+static void lcd_anim_drop(struct lcd_screen *scr);
+static int lcd_set_animation(struct lcd_screen *scr, const struct lcd_anim *req);
+static void lcd_anim_work(struct work_struct *work);
+static void lcd_flush_work(struct work_struct *work);
+
+static unsigned int lcd_region_size(const struct lcd_region *win);
+static unsigned int lcd_region_cell(const struct lcd_region *win, unsigned int pos);
+
+// terminal parser states
+#define LCD_TERM_NORMAL     0
+#define LCD_TERM_ESC        1
+#define LCD_TERM_CSI        2
+#define LCD_TERM_MAX_PARAMS 2
+struct lcd_term;
+static void lcd_term_reset(struct lcd_term *term);
+static void lcd_term_erase(struct lcd_screen *scr, unsigned int first, unsigned int last);
+static void lcd_term_newline(struct lcd_screen *scr);
+static unsigned int lcd_term_param(struct lcd_term *term, unsigned int n, unsigned int def);
+static void lcd_term_csi(struct lcd_screen *scr, char final);
+static void lcd_term_putc(struct lcd_screen *scr, char c);
+static ssize_t lcd_term_write(struct lcd_screen *scr, const char *ubuf, size_t size);
 static void lcd_clearDisplay(void);
+static void lcd_returnHome(void);
+static void lcd_fast_command(unsigned char command);
 static void lcd_shift_left(void);
 static void lcd_shift_right(void);
 
 
+static int lcd_wall_init(dev_t devno);
+static void lcd_wall_free(void);
+static void lcd_wall_update(void);
+static int lcd_wall_open(struct inode *pinode, struct file *pfile);
+static ssize_t lcd_wall_read(struct file *pfile, char *ubuf, size_t size, loff_t *poffset);
+static ssize_t lcd_wall_write(struct file *pfile, const char *ubuf, size_t size, loff_t *poffset);
+static loff_t lcd_wall_llseek(struct file *pfile, loff_t offset, int whence);
+
+static struct lcd_screen *lcd_screen_new(struct lcd *pdev);
+static struct lcd *lcd_get(unsigned int minor);
+static void lcd_put(struct lcd *pdev);
+static void lcd_idle_work(struct work_struct *work);
+static void lcd_dev_stop(struct lcd *pdev);
+static void lcd_dev_free(struct lcd *pdev);
+static void lcd_devs_stop(void);
+static void lcd_devs_free(void);
+static int lcd_en_of(unsigned int minor);
+
 static int lcd_open(struct inode *pinode, struct file *pfile);
 static int lcd_close(struct inode *pinode, struct file *pfile);
 static ssize_t lcd_read(struct file *pfile, char *ubuf, size_t size, loff_t *poffset);
 static ssize_t lcd_write(struct file *pfile, const char *ubuf, size_t size, loff_t *poffset);
+struct kiocb;
+struct iov_iter;
+static ssize_t lcd_write_iter(struct kiocb *iocb, struct iov_iter *from);
+static ssize_t lcd_write_rows(struct lcd_screen *scr, struct iov_iter *from);
+static ssize_t lcd_write_stream(struct lcd_screen *scr, struct kiocb *iocb, struct iov_iter *from);
+static loff_t lcd_llseek(struct file *pfile, loff_t offset, int whence);
+static __poll_t lcd_poll(struct file *pfile, struct poll_table_struct *wait);
+static int lcd_fsync(struct file *pfile, loff_t start, loff_t end, int datasync);
 static long lcd_ioctl(struct file *, unsigned int, unsigned long param);
 
 
@@ -0,0 +1,30 @@
+#ifndef __BBB_LCD_HW
+#define __BBB_LCD_HW
+
+// no kernel types in here, lcd_test uses the same geometry from userspace
+
+#define BV(n)       (1 << (n))
+
+#define LCD_RS   67  // P8_8
+#define LCD_RW   68  // P8_10 GND
+#define LCD_EN   44  // P8_12
+#define LCD_D4   26  // P8_14
+#define LCD_D5   46  // P8_16
+#define LCD_D6   65  // P8_18
+#define LCD_D7   61  // P8_26
+
+#define LCD_LINE_NUM_ONE    1
+#define LCD_LINE_NUM_TWO    2
+#define LCD_LINE1_ADD 		0x80
+#define LCD_LINE2_ADD 		0xC0
+#define NUM_CHARS_PER_LINE  16
+#define NUM_LINES           2
+#define LCD_CELLS           (NUM_LINES * NUM_CHARS_PER_LINE)
+#define LCD_DDRAM_COLS      40  // DDRAM holds 40 characters per line, NUM_CHARS_PER_LINE of them are visible
+#define LCD_PAGES           2   // full screens that fit side by side into DDRAM
+#define LCD_DDRAM_ADDR(row, col)    ((row) * (LCD_LINE2_ADD - LCD_LINE1_ADD) + (col))
+
+#define LCD_CMD		    0
+#define LCD_DATA	    1
+
+#endif
@@ -1,4 +1,5 @@
 #include <linux/module.h>
+#include <linux/version.h>
 #include <linux/fs.h>
 #include <linux/device.h>
 #include <linux/cdev.h>
@@ -7,13 +8,35 @@
 #include <linux/gpio.h>  // linux gpio interface
 #include <linux/delay.h> // delay
 #include <linux/string.h>
-#include <linux/kfifo.h>
 #include <linux/slab.h>
 #include <linux/timer.h>
 #include <linux/mutex.h>
+#include <linux/io.h>
+#include <linux/list.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/eventfd.h>
+#include <linux/time.h>
+#include <linux/timekeeping.h>
+#include <linux/sched/loadavg.h>
+#include <linux/capability.h>
+#include <linux/uio.h>
+#include <linux/io_uring.h>
+// io_uring commands need the API of 6.7, where they can be canceled, older kernels only get the ioctls
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+#define LCD_URING
+#include <linux/io_uring/cmd.h>
+#endif
+#include <linux/debugfs.h>
+#include <linux/vmalloc.h>
+#include <linux/namei.h>
+#include <linux/magic.h>
+#include <linux/cred.h>
 
 #include "bbb_lcd.h"
 #include "bbb_ioctl.h"
+#include "bbb_gpio_regs.h"
 
 static struct file_operations f_ops = {
     .owner = THIS_MODULE,
@@ -21,15 +44,149 @@ static struct file_operations f_ops = {
     .release = lcd_close,
     .read = lcd_read,
     .write = lcd_write,
+    .write_iter = lcd_write_iter,
+    .splice_write = iter_file_splice_write,
+    .llseek = lcd_llseek,
+    .poll = lcd_poll,
+    .fsync = lcd_fsync,
+#ifdef LCD_URING
+    .uring_cmd = lcd_uring_cmd,
+#endif
     .unlocked_ioctl = lcd_ioctl
 };
 
+static struct file_operations wall_f_ops = {
+    .owner = THIS_MODULE,
+    .open = lcd_wall_open,
+    .read = lcd_wall_read,
+    .write = lcd_wall_write,
+    .llseek = lcd_wall_llseek
+};
+
+// state of the escape sequence parser used in LCD_MODE_TERMINAL
+struct lcd_term
+{
+    unsigned int row, col;              // cursor, where the next character goes
+    unsigned int saved_row, saved_col;  // ESC 7 / CSI s
+    int state;                          // LCD_TERM_NORMAL, LCD_TERM_ESC or LCD_TERM_CSI
+    unsigned int param[LCD_TERM_MAX_PARAMS];
+    unsigned int nparam;
+};
+
+// state of one panel, allocated when its minor is first opened and released again once it is idle
 struct lcd
 {
-    dev_t lcd_devno;
+    unsigned int minor;
+    int users;                  // open files and wall tiles, under dev_lock
+    struct delayed_work idle_work;      // releases the panel idle_ms after the last user
+    bool stale;                 // the panel may show anything, blanked before the first flush
+
+    struct mutex screens_lock;  // protects screens, active and the selection state below
+    struct list_head screens;   // lcd_screen of every file opened for writing
+    struct lcd_screen *active;  // screen composited to the panel, NULL keeps the last frame
+    int policy;                 // LCD_SELECT_*
+    unsigned int next_id;
+    unsigned long write_seq;    // orders writes for LCD_SELECT_LATEST/LCD_SELECT_PRIORITY
+    unsigned long next_expiry;  // jiffies of the first screen to expire, 0 for none
+    struct delayed_work expire_work;    // takes expired screens off the panel
+    bool blank;                 // the active screen expired with nothing to take its place
+    struct work_struct flush_work;      // composites the active screen and sends the diff
+    struct delayed_work rotate_work;    // LCD_SELECT_ROUND_ROBIN
+    atomic_t submit_seq;        // bumped for every flush queued, a frame is shown once shown_seq reaches it
+    wait_queue_head_t shown_wq; // woken when shown_seq advances, poll() and fsync()
+    struct list_head events;    // lcd_screen with an eventfd for LCD_SET_EVENTFD, under screens_lock
+    spinlock_t uring_lock;
+    struct list_head uring_cmds;        // io_uring commands waiting for their frame, lcd_uring_pdu
+
+    struct mutex widgets_lock;  // protects widgets, taken after screens_lock
+    struct list_head widgets;   // lcd_widget drawn on top of the screens
+    unsigned int next_widget;
+    struct delayed_work widget_work;    // reads the widget files every widget_ms, on system_wq
+    struct work_struct widget_render_work;  // renders the widgets with what widget_work read
+    struct delayed_work scrub_work;     // reads DDRAM back every scrub_ms, rw_wired
+    unsigned int scrub_pos;     // next DDRAM cell the scrubber reads, under frame_lock
+
+    int en;                     // EN line of this panel, lcd_en= or the LCD_EN all others share
+    unsigned int mirror;        // mirror group, 0 for none. Changed under frame_lock and bus_lock
+
+    struct mutex frame_lock;    // protects frame and the hardware state below
+    char frame[LCD_CELLS];      // what the panel shows, cell = row * NUM_CHARS_PER_LINE + col
+    unsigned int frame_seq;     // bumped whenever frame changes, LCD_GET_SNAPSHOT
+    unsigned int shown_seq;     // submit_seq the last finished flush covered
+    char ddram[NUM_LINES][LCD_DDRAM_COLS]; // what the HD44780 holds in its DDRAM
+    int ac;                     // DDRAM address counter of the HD44780, -1 when unknown
+    unsigned char glyphs[LCD_GLYPHS][LCD_GLYPH_ROWS];   // user characters 0-7, LCD_URING_GLYPH
+    unsigned int glyph_dirty;   // BV(glyph) of the glyphs the next flush writes into CGRAM
+    bool page_flip;             // draw into the hidden DDRAM page and shift it into view
+    unsigned int page;          // visible page, DDRAM columns page * NUM_CHARS_PER_LINE onwards
+    unsigned int shift;         // display shift, DDRAM column shown in the first visible column
+                                // in a mirror group ddram, ac, page and shift are written by the
+                                // group leader, always under bus_lock
+};
+
+// text the driver keeps up to date by itself in a region of the panel, LCD_ADD_WIDGET
+struct lcd_widget
+{
+    struct list_head node;      // in lcd->widgets
+    unsigned int id;            // handle for LCD_DEL_WIDGET
+    int type;                   // LCD_WIDGET_*
+    struct lcd_region win;
+    struct path file;           // LCD_WIDGET_FILE, resolved and checked once by lcd_add_widget()
+    char text[LCD_CELLS + 1];   // LCD_WIDGET_FILE, first line of the file as widget_work read it
+    char cells[LCD_CELLS];      // rendered text, only the cells of win are used
+};
+
+// kept in the pdu of an io_uring command until the frame it submitted is on the panel
+struct lcd_uring_pdu
+{
+    struct list_head node;      // in lcd->uring_cmds
+    struct io_uring_cmd *cmd;
+    unsigned int seq;           // submit_seq the panel has to reach
+    int res;                    // for the cqe
+};
+
+// virtual screen of one open file, the driver composites the active one to the panel
+struct lcd_screen
+{
+    struct lcd *pdev;
+    struct list_head node;      // in lcd->screens, empty for files opened read only
+    struct mutex lock;          // serializes writers of this screen
+    unsigned int id;            // handle for LCD_SHOW_SCREEN
+    int prio;                   // LCD_SELECT_PRIORITY shows the highest
+    unsigned long stamp;        // write_seq of the last write to this screen
+    unsigned int ttl_ms;        // LCD_SET_TTL, 0 keeps what is written for good
+    unsigned long expires;      // jiffies at which the last write stops mattering, 0 never. Under screens_lock
+    int mode;                   // LCD_MODE_CELLS or LCD_MODE_TERMINAL
+    struct lcd_term term;
+    bool leased;                // owns 'win' through LCD_SET_REGION instead of competing for the panel
+    struct lcd_region win;      // cells this file addresses, the whole panel unless leased
+    unsigned int seen_seq;      // shown_seq last handed to this file, poll() reports anything newer
+    struct eventfd_ctx *event;  // signalled whenever a frame reaches the panel
+    struct list_head event_node;
+    char *pages;                // LCD_MODE_PAGING, the message laid out as npages windows
+    unsigned int npages;
+    unsigned int page;          // page in cells
+    struct delayed_work page_work;      // moves on to the next page every page_ms
+    struct lcd_anim_frame *anim;        // LCD_SET_ANIMATION, NULL when none plays
+    unsigned int anim_n;
+    unsigned int anim_pos;      // step in cells
+    bool anim_loop;
+    unsigned long anim_next;    // jiffies at which the step after anim_pos is due
+    struct delayed_work anim_work;
+    char cells[LCD_CELLS];
+};
+
+// panels tiled into one large display, /dev/bbb_lcd_wall0
+struct lcd_wall
+{
+    dev_t devno;
     struct cdev cdev;
-    struct kfifo dev_buf;
-    struct mutex lock;
+    struct mutex lock;          // serializes writers of the wall, taken before any lock of the panels
+    unsigned int width;         // cells per row of the whole wall
+    unsigned int height;
+    struct lcd_screen **tile;   // screen the wall owns on each panel, tile row by tile row
+    bool live;                  // the tile screens compete for their panels since the first write
+    char *cells;                // what was written to the wall, cell = row * width + col
 };
 
 static int lcd_pin[] = {
@@ -44,42 +201,199 @@ static int lcd_pin[] = {
 static struct class *pclass;
 static int major;
 
-static struct lcd *dev;
+// all the panels share the same RS/EN/D4-D7 pins, only one transfer can be on the bus at a time
+static DEFINE_MUTEX(bus_lock);
+
+// runs the flushes of all panels one after the other, they share the bus anyway
+static struct workqueue_struct *lcd_wq;
+
+static struct lcd **dev;        // panel of every minor, NULL while it is not in use
+static struct cdev lcd_cdev;    // all the panel minors
+
+// protects dev[] and lcd->users, taken before any other lock. dev[] also only changes under bus_lock.
+static DEFINE_MUTEX(dev_lock);
+
+// how long a panel nobody uses keeps its state
+static unsigned int idle_ms = 10000;
+module_param(idle_ms, uint, 0644);
+
 static int dev_cnt = 1;
 module_param(dev_cnt, int, 0100);
 
+// drive the lcd pins through the AM335x SETDATAOUT/CLEARDATAOUT registers instead of gpiolib
+static bool use_mmio;
+module_param(use_mmio, bool, 0444);
+
+// how long each screen is shown with LCD_SELECT_ROUND_ROBIN
+static unsigned int rotate_ms = 5000;
+module_param(rotate_ms, uint, 0644);
+
+// run without lcd, nothing is written to the pins and the bus delays are only accounted in bus_stats
+static bool dry_run;
+module_param(dry_run, bool, 0444);
+
+// nibbles and modelled bus time since the module was loaded, LCD_GET_BUS_STATS. Protected by bus_lock.
+static struct lcd_bus_stats bus_stats;
+
+// RW is wired to the BBB instead of ground, the panels can be read back
+static bool rw_wired;
+module_param(rw_wired, bool, 0444);
+
+// the RW line is requested and the panels are initialized, lcd_get() starts the scrubber. Protected by dev_lock.
+static bool rw_ready;
+
+// measure the busy times of every panel that can be read back when the module is loaded, needs rw_wired
+static bool calibrate;
+module_param(calibrate, bool, 0444);
+
+// percent added to the measured busy times before they are waited out
+static unsigned int timing_margin = 50;
+module_param(timing_margin, uint, 0644);
+
+// how much later than asked usleep_range() returned in the last calibration, shorter waits spin instead
+static unsigned int sleep_overshoot_us;
+module_param(sleep_overshoot_us, uint, 0444);
+
+// measured busy times per minor, kept while the panel is released. /sys/class/bbb_lcd/bbb_lcdN/*_us
+static struct lcd_timing *timing;
+
+// kB of the ring every nibble on the bus is recorded into, read from debugfs bbb_lcd/capture. 0 for no capture
+static unsigned int capture_kb;
+module_param(capture_kb, uint, 0444);
+
+// the capture ring, written under bus_lock. capture_head counts every record since the module was loaded
+static struct lcd_capture_rec *capture;
+static unsigned int capture_len;
+static unsigned long long capture_head;
+static struct dentry *lcd_debugfs;
+
+static const struct file_operations capture_f_ops =
+{
+    .owner = THIS_MODULE,
+    .read = lcd_capture_read,
+    .llseek = default_llseek,
+};
+
+// minors on the EN lines lcd_bus_select() chose, for the capture
+static unsigned int bus_panels;
+
+// waits of the selected panels with timing_margin, set by lcd_bus_select(), and what the last transfer needs
+static struct lcd_timing bus_timing = {LCD_BUSY_DEFAULT_US, LCD_BUSY_DEFAULT_US, LCD_BUSY_DEFAULT_US};
+static unsigned int bus_wait_us = LCD_BUSY_DEFAULT_US;
+// wait after a display shift, the datasheet time unless every selected panel was calibrated
+static unsigned int bus_fast_us = LCD_FAST_CMD_US;
+
+// how often the scrubber reads LCD_SCRUB_CELLS cells back from every panel, 0 stops it
+static unsigned int scrub_ms = 200;
+module_param(scrub_ms, uint, 0644);
+
+// EN line of each panel, panels without an entry share LCD_EN
+static int lcd_en[LCD_MAX_EN];
+static int lcd_en_cnt;
+module_param_array(lcd_en, int, &lcd_en_cnt, 0444);
+
+// EN lines lcd_write_nibble() strobes and the other panels whose mirrors follow, set by lcd_bus_select()
+static int bus_en[LCD_MAX_EN + 1];
+static unsigned int bus_en_cnt;
+static unsigned int bus_en_mask[LCD_GPIO_BANKS];    // bus_en for the register backend
+static struct lcd *bus_group[LCD_MAX_EN];
+static unsigned int bus_group_cnt;
+
+// wall_cols x wall_rows panels, minors 0 onwards row by row, make up /dev/bbb_lcd_wall0. 0 for no wall
+static unsigned int wall_cols;
+module_param(wall_cols, uint, 0444);
+static unsigned int wall_rows = 1;
+module_param(wall_rows, uint, 0444);
+static struct lcd_wall wall;
+
+// how long each page of a LCD_MODE_PAGING message is shown
+static unsigned int page_ms = 3000;
+module_param(page_ms, uint, 0644);
+
+// how often the widgets are refreshed
+static unsigned int widget_ms = 1000;
+module_param(widget_ms, uint, 0644);
+
+static const unsigned long gpio_bank_base[LCD_GPIO_BANKS] = {GPIO0_BASE, GPIO1_BASE, GPIO2_BASE};
+static void __iomem *gpio_bank[LCD_GPIO_BANKS];
+
+// a measured busy time of the panel, written back to restore a calibration saved from an earlier boot
+#define LCD_TIMING_ATTR(field)                                                                      \
+static ssize_t field##_show(struct device *d, struct device_attribute *attr, char *buf)            \
+{                                                                                                   \
+    return sysfs_emit(buf, "%u\n", READ_ONCE(timing[MINOR(d->devt)].field));                       \
+}                                                                                                   \
+static ssize_t field##_store(struct device *d, struct device_attribute *attr, const char *buf, size_t len) \
+{                                                                                                   \
+    unsigned int us;                                                                                \
+    int ret = kstrtouint(buf, 0, &us);                                                              \
+                                                                                                    \
+    if (ret != 0)                                                                                   \
+        return ret;                                                                                 \
+    if (us > LCD_BUSY_TIMEOUT_US)                                                                   \
+        return -EINVAL;                                                                             \
+    WRITE_ONCE(timing[MINOR(d->devt)].field, us);                                                   \
+    return len;                                                                                     \
+}                                                                                                   \
+static DEVICE_ATTR_RW(field)
+
+LCD_TIMING_ATTR(cmd_us);
+LCD_TIMING_ATTR(data_us);
+LCD_TIMING_ATTR(home_us);
+
+static struct attribute *lcd_timing_attrs[] = {
+    &dev_attr_cmd_us.attr,
+    &dev_attr_data_us.attr,
+    &dev_attr_home_us.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(lcd_timing);
+
 static __init int lcd_init(void)
 {
-    int i, ret, minor;
+    int ret, minor;
     struct device *pdevice;
     dev_t devno;
+    int i = 0;
 
     printk(KERN_INFO "%s : lcd_init() is called\n", THIS_MODULE->name);
 
-    // depending upon the device count(dev_cnt) allocting the memory for device(s)
-    dev = (struct lcd *)kmalloc(dev_cnt * sizeof(struct lcd), GFP_KERNEL);
+    if (wall_cols != 0 && (wall_rows == 0 || wall_cols * wall_rows > dev_cnt))
+    {
+        printk(KERN_INFO "%s : a %ux%u wall needs more than %d devices\n", THIS_MODULE->name, wall_cols, wall_rows, dev_cnt);
+        return -EINVAL;
+    }
+
+    // only a pointer per minor, the panel state is allocated by lcd_get() on first use
+    dev = kcalloc(dev_cnt, sizeof(*dev), GFP_KERNEL);
     if (dev == NULL)
     {
         ret = -ENOMEM;
         printk(KERN_INFO "%s : kmalloc is failed\n", THIS_MODULE->name);
         goto dev_kmalloc_failed;
     }
+    timing = kcalloc(dev_cnt, sizeof(*timing), GFP_KERNEL);
+    if (timing == NULL)
+    {
+        ret = -ENOMEM;
+        kfree(dev);
+        dev = NULL;
+        printk(KERN_INFO "%s : kmalloc is failed\n", THIS_MODULE->name);
+        goto dev_kmalloc_failed;
+    }
     printk(KERN_INFO "%s : kamlloc is success\n", THIS_MODULE->name);
 
-    //for each device alloctig the kfifo memory 
-    for (i = 0; i < dev_cnt; i++)
+    lcd_wq = alloc_ordered_workqueue("bbb_lcd", 0);
+    if (lcd_wq == NULL)
     {
-        ret = kfifo_alloc(&dev[i].dev_buf, FIFO_SIZE, GFP_KERNEL);
-        if (ret != 0)
-        {
-            printk(KERN_INFO "%s : kfifo_alloc is failed for %d lcd device\n", THIS_MODULE->name, i);
-            goto kfifo_alloc_failed;
-        }
+        ret = -ENOMEM;
+        printk(KERN_INFO "%s : alloc_ordered_workqueue() failed\n", THIS_MODULE->name);
+        goto alloc_workqueue_failed;
     }
-    printk(KERN_INFO "%s : kfifo_alloc is success\n", THIS_MODULE->name);
 
     // allocating character device number to the device driver
-    ret = alloc_chrdev_region(&devno, 0, dev_cnt, "bbb_lcd");
+    // the wall takes the minor after the panels
+    ret = alloc_chrdev_region(&devno, 0, dev_cnt + (wall_cols ? 1 : 0), "bbb_lcd");
     if (ret < 0)
     {
         printk(KERN_INFO "%s : alloc_chrdev_region() failed\n", THIS_MODULE->name);
@@ -90,7 +404,11 @@ static __init int lcd_init(void)
     printk(KERN_INFO "%s : alloc_chrdev_region() is success. devno: %d/%d\n", THIS_MODULE->name, major, minor);
 
     // creating the class for device(s)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+    pclass = class_create("bbb_lcd");
+#else
     pclass = class_create(THIS_MODULE, "bbb_lcd");
+#endif
     if (IS_ERR(pclass))
     {
         printk(KERN_INFO "%s : class_create() failed\n", THIS_MODULE->name);
@@ -101,68 +419,147 @@ static __init int lcd_init(void)
     // creating the multiple devices for lcd in sysfs
     for (i = 0; i < dev_cnt; i++)
     {
-        dev[i].lcd_devno = MKDEV(major, i);
-        pdevice = device_create(pclass, NULL, dev[i].lcd_devno, NULL, "bbb_lcd%d", i);
+        pdevice = device_create_with_groups(pclass, NULL, MKDEV(major, i), NULL, lcd_timing_groups, "bbb_lcd%d", i);
         if (IS_ERR(pdevice))
         {
             printk(KERN_INFO "%s : device_create() no.%d is failed\n", THIS_MODULE->name, i);
             ret = -1;
             goto device_create_failed;
         }
-        printk(KERN_INFO "%s : device_create() no.%d is success.\n", THIS_MODULE->name, i);
     }
+    printk(KERN_INFO "%s : device_create() of %d devices is success.\n", THIS_MODULE->name, dev_cnt);
 
-    // filling cdev structure of particular devices with their file_operation and then adding into global cdev_map
-    for (i = 0; i < dev_cnt; i++)
+    // one cdev for all the panel minors, lcd_open() finds the panel by minor
+    cdev_init(&lcd_cdev, &f_ops);
+    ret = cdev_add(&lcd_cdev, MKDEV(major, 0), dev_cnt);
+    if (ret != 0)
+    {
+        printk(KERN_INFO "%s : cdev_add() failed\n", THIS_MODULE->name);
+        goto cdev_add_failed;
+    }
+    printk(KERN_INFO "%s : cdev_add() is success. \n", THIS_MODULE->name);
+
+    if (wall_cols != 0)
     {
-        cdev_init(&dev[i].cdev, &f_ops);
-        ret = cdev_add(&dev[i].cdev, dev[i].lcd_devno, 1);
+        ret = lcd_wall_init(MKDEV(major, dev_cnt));
         if (ret != 0)
         {
-            printk(KERN_INFO "%s : cdev_add() failed\n", THIS_MODULE->name);
-            goto cdev_add_failed;
+            printk(KERN_INFO "%s : lcd_wall_init() failed\n", THIS_MODULE->name);
+            goto lcd_wall_init_failed;
         }
-        printk(KERN_INFO "%s : cdev_add() is success. \n", THIS_MODULE->name);
     }
 
-    // allocting the mutex for each device(s) 
-    for(i=0; i<dev_cnt; i++)
-        mutex_init(&dev[i].lock);
-    printk(KERN_INFO "%s: mutex_init() initialized mutex lock for all devices.\n", THIS_MODULE->name);
-
     // initializing the BBB pin
-    ret = lcd_all_pin_init();
+    ret = dry_run ? 0 : lcd_all_pin_init();
     if (ret != 0)
     {
         printk(KERN_INFO "%s : Lcd_all_pin_init is failed\n", THIS_MODULE->name);
         goto Lcd_all_pin_init_failed;
     }
-    // initializing the lcd
+
+    // EN lines of the panels that have one of their own
+    ret = dry_run ? 0 : lcd_en_pin_init();
+    if (ret != 0)
+    {
+        printk(KERN_INFO "%s : lcd_en_pin_init is failed\n", THIS_MODULE->name);
+        goto lcd_en_pin_init_failed;
+    }
+
+    // RW stays low except while the scrubber reads
+    ret = (dry_run || !rw_wired) ? 0 : lcd_rw_pin_init();
+    if (ret != 0)
+    {
+        printk(KERN_INFO "%s : lcd_rw_pin_init is failed\n", THIS_MODULE->name);
+        goto lcd_rw_pin_init_failed;
+    }
+
+    // mapping the gpio banks when the register backend is selected
+    if (use_mmio && !dry_run)
+    {
+        ret = lcd_mmio_init();
+        if (ret != 0)
+        {
+            printk(KERN_INFO "%s : lcd_mmio_init is failed\n", THIS_MODULE->name);
+            goto lcd_mmio_init_failed;
+        }
+    }
+    // before lcd_initialize() so a capture holds the panels from power on
+    if (capture_kb != 0)
+    {
+        ret = lcd_capture_init();
+        if (ret != 0)
+        {
+            printk(KERN_INFO "%s : lcd_capture_init is failed\n", THIS_MODULE->name);
+            goto lcd_capture_init_failed;
+        }
+    }
+    // initializing all the lcds at once
+    mutex_lock(&bus_lock);
+    lcd_bus_select(NULL, 0);
     lcd_initialize();
+    // the panels are blank now, the calibration writes a space back to DDRAM address 0
+    if (calibrate && rw_wired && !dry_run)
+    {
+        for (i = 0; i < dev_cnt; i++)
+        {
+            if (lcd_en_shared(i) || lcd_calibrate(i, ' ') != 0)
+                printk(KERN_INFO "%s : panel %d cannot be calibrated, keeps the default timing\n", THIS_MODULE->name, i);
+        }
+    }
+    mutex_unlock(&bus_lock);
+
+    // the panels of the wall were taken before RW was set up, their scrubbers start here
+    if (rw_wired && !dry_run)
+    {
+        mutex_lock(&dev_lock);
+        rw_ready = true;
+        for (i = 0; i < dev_cnt; i++)
+        {
+            if (dev[i] != NULL && scrub_ms != 0)
+                queue_delayed_work(lcd_wq, &dev[i]->scrub_work, msecs_to_jiffies(scrub_ms));
+        }
+        mutex_unlock(&dev_lock);
+    }
     printk(KERN_INFO "%s : Lcd_init() success \n", THIS_MODULE->name);
     
     return 0;
 
+lcd_capture_init_failed:
+    if (use_mmio && !dry_run)
+        lcd_mmio_free();
+lcd_mmio_init_failed:
+    if (rw_wired)
+        gpio_free(LCD_RW);
+lcd_rw_pin_init_failed:
+    lcd_en_pin_free();
+lcd_en_pin_init_failed:
+    lcd_all_pin_free();
 Lcd_all_pin_init_failed:
+    if (wall_cols != 0)
+    {
+        lcd_devs_stop();
+        lcd_wall_free();
+    }
+lcd_wall_init_failed:
+    cdev_del(&lcd_cdev);
 cdev_add_failed:
-    for (i = i - 1; i >= 0; i--)
-        cdev_del(&dev[i].cdev);
-
     i = dev_cnt;
 device_create_failed:
     for (i = i - 1; i >= 0; i--)
-        device_destroy(pclass, dev[i].lcd_devno);
+        device_destroy(pclass, MKDEV(major, i));
 
     class_destroy(pclass);
 class_create_failed:
     unregister_chrdev_region(devno, 1);
 alloc_chrdev_region_failed:
-    i = dev_cnt;
-kfifo_alloc_failed:
-    for (i = dev_cnt - 1; i >= 0; i--)
-        kfifo_free(&dev[i].dev_buf);
-
+    lcd_devs_free();
+    destroy_workqueue(lcd_wq);
+alloc_workqueue_failed:
+    // built in, the KUnit suite still runs after a failed init and checks these
+    kfree(timing);
+    timing = NULL;
     kfree(dev);
+    dev = NULL;
 dev_kmalloc_failed:
     return ret;
 }
@@ -173,304 +570,3074 @@ static __exit void lcd_exit(void)
     dev_t devno = MKDEV(major, 0);
     printk(KERN_INFO "%s : lcd_exit() is called\n", THIS_MODULE->name);
 
-    lcd_all_pin_free();
-    printk(KERN_INFO "%s : Lcd_all_pin_free pin are free\n", THIS_MODULE->name);
+    // no file is open any more, only the timers and works of the panels in use can still be around
+    lcd_devs_stop();
+    if (wall_cols != 0)
+        lcd_wall_free();
+    lcd_devs_free();
+    destroy_workqueue(lcd_wq);
+    lcd_capture_free();
+
+    // dry_run never took the pins
+    if (!dry_run)
+    {
+        if (use_mmio)
+            lcd_mmio_free();
 
-    for(i=dev_cnt-1; i>=0; i--)
-    mutex_destroy(&dev[i].lock);
-    printk(KERN_INFO "%s: mutex_destroy() destroyed mutex locks for all devices.\n", THIS_MODULE->name);
+        if (rw_wired)
+            gpio_free(LCD_RW);
+        lcd_en_pin_free();
+        lcd_all_pin_free();
+        printk(KERN_INFO "%s : Lcd_all_pin_free pin are free\n", THIS_MODULE->name);
+    }
 
-    for (i =dev_cnt-1; i >=0 ; i--)
-        cdev_del(&dev[i].cdev);
+    cdev_del(&lcd_cdev);
     printk(KERN_INFO "%s : cdev_del() is successful \n", THIS_MODULE->name);
 
     for (i = dev_cnt-1; i >= 0; i--)
-        device_destroy(pclass, dev[i].lcd_devno);
+        device_destroy(pclass, MKDEV(major, i));
     printk(KERN_INFO "%s : device_destroy() is successful\n", THIS_MODULE->name);
 
     class_destroy(pclass);
     printk(KERN_INFO "%s : class_destroy() is successful \n", THIS_MODULE->name);
 
-    unregister_chrdev_region(devno, dev_cnt);
+    unregister_chrdev_region(devno, dev_cnt + (wall_cols ? 1 : 0));
     printk(KERN_INFO "%s : unregister_chrdev_region()  is successful\n", THIS_MODULE->name);
 
-    for (i = dev_cnt-1; i >= 0; i--)
-        kfifo_free(&dev[i].dev_buf);
-
-    printk(KERN_INFO "%s : all device kfifo are release\n", THIS_MODULE->name);
-
+    kfree(timing);
     kfree(dev);
     printk(KERN_INFO "%s : kfree released device private struct memory \n", THIS_MODULE->name);
 
     printk(KERN_INFO "%s : lcd_exit() is completed\n", THIS_MODULE->name);
 }
 
-static int lcd_open(struct inode *pinode, struct file *pfile)
-{   // 
-    struct lcd *pdev = container_of(pinode->i_cdev, struct lcd, cdev);
-    printk(KERN_INFO "%s : lcd_open is called\n", THIS_MODULE->name);
-    pfile->private_data = pdev;
-    // locking the device when particular device driver is perforing operation on the lcd so race conditon do not occurs.
-    mutex_lock(&pdev->lock);
-    printk(KERN_INFO "%s: mutex lock is acqired \n", THIS_MODULE->name);
-
-    return 0;
-}
-static int lcd_close(struct inode *pinode, struct file *pfile)
+/*
+ * description:		panel of 'minor', allocated on first use, and one more user of it.
+ *			The panel is blank after lcd_initialize(), but one released before may show
+ *			anything, so a new panel is always blanked before its first frame.
+ * @return		NULL without memory
+ */
+static struct lcd *lcd_get(unsigned int minor)
 {
-    struct lcd *pdev = (struct lcd*)pfile->private_data;
-    printk(KERN_INFO "%s : lcd_close is called\n", THIS_MODULE->name);
-    // as the device driver operation is finished unloking(relasing) the device.
-    mutex_unlock(&pdev->lock);
-    printk(KERN_INFO "%s: mutex is unlock\n", THIS_MODULE->name);
+    struct lcd *pdev;
 
-    return 0;
+    mutex_lock(&dev_lock);
+    pdev = dev[minor];
+    if (pdev == NULL)
+    {
+        pdev = kzalloc(sizeof(*pdev), GFP_KERNEL);
+        if (pdev == NULL)
+        {
+            mutex_unlock(&dev_lock);
+            return NULL;
+        }
+        pdev->minor = minor;
+        INIT_DELAYED_WORK(&pdev->idle_work, lcd_idle_work);
+        mutex_init(&pdev->screens_lock);
+        mutex_init(&pdev->frame_lock);
+        INIT_LIST_HEAD(&pdev->screens);
+        INIT_WORK(&pdev->flush_work, lcd_flush_work);
+        init_waitqueue_head(&pdev->shown_wq);
+        INIT_LIST_HEAD(&pdev->events);
+        spin_lock_init(&pdev->uring_lock);
+        INIT_LIST_HEAD(&pdev->uring_cmds);
+        INIT_DELAYED_WORK(&pdev->rotate_work, lcd_rotate_work);
+        INIT_DELAYED_WORK(&pdev->expire_work, lcd_expire_work);
+        mutex_init(&pdev->widgets_lock);
+        INIT_LIST_HEAD(&pdev->widgets);
+        INIT_DELAYED_WORK(&pdev->widget_work, lcd_widget_work);
+        INIT_WORK(&pdev->widget_render_work, lcd_widget_render_work);
+        INIT_DELAYED_WORK(&pdev->scrub_work, lcd_scrub_work);
+        pdev->policy = LCD_SELECT_LATEST;
+        pdev->en = lcd_en_of(minor);
+        memset(pdev->frame, ' ', sizeof(pdev->frame));
+        memset(pdev->ddram, ' ', sizeof(pdev->ddram));
+        pdev->stale = true;
+
+        // bus_lock, lcd_bus_select() walks dev[]
+        mutex_lock(&bus_lock);
+        dev[minor] = pdev;
+        mutex_unlock(&bus_lock);
+
+        if (rw_ready && scrub_ms != 0)
+            queue_delayed_work(lcd_wq, &pdev->scrub_work, msecs_to_jiffies(scrub_ms));
+    }
+    pdev->users++;
+    // an idle work that already runs sees the user and keeps the panel
+    cancel_delayed_work(&pdev->idle_work);
+    mutex_unlock(&dev_lock);
+    return pdev;
 }
-static ssize_t lcd_read(struct file *pfile, char *ubuf, size_t size, loff_t *poffset)
-{   // You can't read data from lcd so this operation function is not implemented
-    printk(KERN_INFO "%s : lcd_read is called\n", THIS_MODULE->name);
-    return size;
+
+// one user less, the panel is released idle_ms after the last one
+static void lcd_put(struct lcd *pdev)
+{
+    mutex_lock(&dev_lock);
+    if (--pdev->users == 0)
+        queue_delayed_work(lcd_wq, &pdev->idle_work, msecs_to_jiffies(idle_ms));
+    mutex_unlock(&dev_lock);
 }
-static ssize_t lcd_write(struct file *pfile, const char __user *ubuf, size_t size, loff_t *poffset)
+
+/*
+ * description:		release a panel nobody uses. Widgets and a mirror group keep the panel, they are
+ *			configuration that outlives the file that set it up. Runs on lcd_wq like the works
+ *			that drive the panel, so none of them runs alongside it and lcd_exit() drains it
+ *			with the queue.
+ */
+static void lcd_idle_work(struct work_struct *work)
 {
-    int ret, nbytes;
-    struct lcd *pdev = (struct lcd *)pfile->private_data;
-    printk(KERN_INFO "%s : lcd_write is called\n", THIS_MODULE->name);
+    struct lcd *pdev = container_of(to_delayed_work(work), struct lcd, idle_work);
+    bool widgets;
 
-    // making sure that before writing into kfifo it is NULL/reset.
-    kfifo_reset(&pdev->dev_buf);
-    printk("inside lcd_write: size value= %d\n", size);
-    ret = kfifo_from_user(&pdev->dev_buf, ubuf, size, &nbytes);
-    if (ret != 0)
+    mutex_lock(&dev_lock);
+    mutex_lock(&pdev->widgets_lock);
+    widgets = !list_empty(&pdev->widgets);
+    mutex_unlock(&pdev->widgets_lock);
+    if (pdev->users != 0 || READ_ONCE(pdev->mirror) != 0 || widgets)
     {
-        printk(KERN_ERR "%s : bytes not copied from user buffer %d\n", THIS_MODULE->name, ret);
-        return -EFAULT;
+        mutex_unlock(&dev_lock);
+        return;
     }
+    mutex_lock(&bus_lock);
+    dev[pdev->minor] = NULL;
+    mutex_unlock(&bus_lock);
+    mutex_unlock(&dev_lock);
 
-    //before writing data on the lcd clearing the lcd display
-    lcd_clearDisplay();
-
-    lcd_print(&pdev->dev_buf, LCD_LINE_NUM_ONE);
-    printk(KERN_INFO "%s : data written into lcd\n", THIS_MODULE->name);
+    printk(KERN_INFO "%s : panel %u is idle, releasing it\n", THIS_MODULE->name, pdev->minor);
+    lcd_dev_free(pdev);
+}
 
-    return nbytes;
+// stop the timers and works of a panel, nothing queues them any more
+static void lcd_dev_stop(struct lcd *pdev)
+{
+    cancel_delayed_work_sync(&pdev->rotate_work);
+    cancel_delayed_work_sync(&pdev->expire_work);
+    cancel_delayed_work_sync(&pdev->widget_work);
+    cancel_work_sync(&pdev->widget_render_work);
+    cancel_delayed_work_sync(&pdev->scrub_work);
+    cancel_work_sync(&pdev->flush_work);
 }
 
-static long lcd_ioctl(struct file *pfile, unsigned cmd, unsigned long param)
+static void lcd_dev_free(struct lcd *pdev)
 {
-    unsigned int i;
-    switch (cmd)
-    {
-    case LCD_CLEAR_IOCTL:
-        lcd_clearDisplay();
-        printk(KERN_INFO "lcd_ioctl : lcd_clear is called\n");
-        break;
-    case LCD_SHIFT_LEFT:
-        i=(unsigned int)param;
-        printk(KERN_INFO "lcd_ioctl : lcd_shift_left is called\n");
-        while (i>0)
-        {
-            lcd_shift_left();
-            i--;
-        }     
-        break;
-    case LCD_SHIFT_RIGHT:
-        i=(unsigned int)param;
-        printk(KERN_INFO "lcd_ioctl : lcd_shift_right is called\n");
-        while (i>0)
-        {
-            lcd_shift_right();
-            i--;
-        }
-        break;
-    default:
-        printk(KERN_INFO "%s : Invaild cmd\n", THIS_MODULE->name);
-        return -EINVAL;
-        break;
-    }
-    return 0;
+    lcd_dev_stop(pdev);
+    lcd_widgets_free(pdev);
+    mutex_destroy(&pdev->widgets_lock);
+    mutex_destroy(&pdev->frame_lock);
+    mutex_destroy(&pdev->screens_lock);
+    kfree(pdev);
 }
 
-static int lcd_all_pin_init(void)
+// module unload, no idle work may release a panel from here on
+static void lcd_devs_stop(void)
 {
-    int i, ret;
-    int size = ARRAY_SIZE(lcd_pin); // ARRAY_SIZE() is macro define the kernel and it returns the number of elements inside the array
-    bool valid;
-    char *lcd_pin_name[] = {"LCD_RS", "LCD_EN", "LCD_D4", "LCD_D5", "LCD_D6", "LCD_D7"};
+    int i;
 
-    for (i = 0; i < size; i++)
+    mutex_lock(&dev_lock);
+    for (i = 0; i < dev_cnt; i++)
     {
-        valid = gpio_is_valid(lcd_pin[i]);
-        if (!valid)
-        {
-            printk(KERN_INFO "%s: GPIO pin %d is invalid\n", THIS_MODULE->name, lcd_pin[i]);
-            ret = -EINVAL;
-            goto gpio_invalid;
-        }
-        printk(KERN_INFO "%s : GPIO pin %d is valid\n", THIS_MODULE->name, lcd_pin[i]);
-
-        ret = gpio_request(lcd_pin[i], lcd_pin_name[i]);
-        if (ret != 0)
-        {
-            printk(KERN_INFO "%s : GPIO pid %d is busy\n", THIS_MODULE->name, lcd_pin[i]);
-            ret = -EBUSY;
-            goto gpio_invalid;
-        }
-
-        ret = gpio_direction_output(lcd_pin[i], 0);
-        if (ret != 0)
-        {
-            printk(KERN_INFO "%s : GPIO pin %d direction is not set\n", THIS_MODULE->name, lcd_pin[i]);
-            ret = -EIO;
-            goto gpio_dirction_failed;
-        }
-        printk(KERN_INFO "%s : GPIO pin %d direction set as output\n", THIS_MODULE->name, lcd_pin[i]);
+        if (dev[i] != NULL)
+            dev[i]->users++;
     }
+    mutex_unlock(&dev_lock);
 
-    printk(KERN_INFO "%s : Lcd_all_pin_init is successful\n", THIS_MODULE->name);
-
-    return 0;
-
-gpio_dirction_failed:
-    gpio_free(lcd_pin[i]);
-gpio_invalid:
-    for (i = i - 1; i > 0; i--)
-        gpio_free(lcd_pin[i]);
-
-    return ret;
+    for (i = 0; i < dev_cnt; i++)
+    {
+        if (dev[i] == NULL)
+            continue;
+        cancel_delayed_work_sync(&dev[i]->idle_work);
+        lcd_dev_stop(dev[i]);
+    }
+    // a panel its idle work took off dev[] before the users above is still being freed
+    flush_workqueue(lcd_wq);
 }
 
-static void lcd_all_pin_free(void)
+static void lcd_devs_free(void)
 {
-    int i, size;
-    size = ARRAY_SIZE(lcd_pin);
+    int i;
 
-    for (i = 0; i < size; i++)
+    lcd_devs_stop();
+    for (i = 0; i < dev_cnt; i++)
     {
-        gpio_free(lcd_pin[i]);// releasing the all the gpio pin of BBB
+        if (dev[i] != NULL)
+            lcd_dev_free(dev[i]);
+        dev[i] = NULL;
     }
 }
 
-static void lcd_instruction(char command)
+// EN line of the panel of 'minor'
+static int lcd_en_of(unsigned int minor)
+{
+    return (minor < lcd_en_cnt) ? lcd_en[minor] : LCD_EN;
+}
+
+static int lcd_open(struct inode *pinode, struct file *pfile)
 {
-    int db7_data = 0;
-    int db6_data = 0;
-    int db5_data = 0;
-    int db4_data = 0;
+    struct lcd *pdev;
+    struct lcd_screen *scr;
+    printk(KERN_INFO "%s : lcd_open is called\n", THIS_MODULE->name);
 
-    usleep_range(2000, 3000); // added delay instead of busy checking
+    pdev = lcd_get(iminor(pinode));
+    if (pdev == NULL)
+        return -ENOMEM;
 
-    // Upper 4 bit data (DB7 to DB4)
-    db7_data = ((command) & (0x1 << 7)) >> (7);
-    db6_data = ((command) & (0x1 << 6)) >> (6);
-    db5_data = ((command) & (0x1 << 5)) >> (5);
-    db4_data = ((command) & (0x1 << 4)) >> (4);
+    // every open file gets its own virtual screen, so nobody waits for the panel at open
+    scr = lcd_screen_new(pdev);
+    if (scr == NULL)
+    {
+        lcd_put(pdev);
+        return -ENOMEM;
+    }
 
-    gpio_set_value(LCD_D7, db7_data);
-    gpio_set_value(LCD_D6, db6_data);
-    gpio_set_value(LCD_D5, db5_data);
-    gpio_set_value(LCD_D4, db4_data);
+    // like a file, the screen starts with what is shown unless it is opened with O_TRUNC
+    if ((pfile->f_mode & FMODE_WRITE) && (pfile->f_flags & O_TRUNC))
+    {
+        lcd_screen_clear(scr);
+    }
+    else
+    {
+        mutex_lock(&pdev->frame_lock);
+        memcpy(scr->cells, pdev->frame, LCD_CELLS);
+        mutex_unlock(&pdev->frame_lock);
+    }
+    scr->seen_seq = READ_ONCE(pdev->shown_seq);
 
-    // Set to command mode
-    gpio_set_value(LCD_RS, LCD_CMD);
-    usleep_range(5, 10);
+    if (pfile->f_mode & FMODE_WRITE)
+    {
+        mutex_lock(&pdev->screens_lock);
+        scr->id = ++pdev->next_id;
+        list_add_tail(&scr->node, &pdev->screens);
+        mutex_unlock(&pdev->screens_lock);
+    }
 
-    // Simulating falling edge triggered clock
-    gpio_set_value(LCD_EN, 1);
-    usleep_range(5, 10);
-    gpio_set_value(LCD_EN, 0);
+    pfile->private_data = scr;
+    return 0;
 }
-
-/*
- * description:		send a 1-byte ASCII character data to the HD44780 LCD controller.
- * @param data		a 1-byte data to be sent to the LCD controller. Both the upper 4 bits and the lower 4 bits are used.
- */
-static void lcd_data(char data)
+// a screen of the whole panel in cells mode, not yet competing for the panel
+static struct lcd_screen *lcd_screen_new(struct lcd *pdev)
 {
-    int db7_data = 0;
-    int db6_data = 0;
-    int db5_data = 0;
-    int db4_data = 0;
+    struct lcd_screen *scr;
 
+    scr = kzalloc(sizeof(*scr), GFP_KERNEL);
+    if (scr == NULL)
+        return NULL;
+    scr->pdev = pdev;
+    mutex_init(&scr->lock);
+    INIT_LIST_HEAD(&scr->node);
+    INIT_LIST_HEAD(&scr->event_node);
+    INIT_DELAYED_WORK(&scr->page_work, lcd_page_work);
+    INIT_DELAYED_WORK(&scr->anim_work, lcd_anim_work);
+    scr->mode = LCD_MODE_CELLS;
+    lcd_term_reset(&scr->term);
+    scr->win.width = NUM_CHARS_PER_LINE;
+    scr->win.height = NUM_LINES;
+    return scr;
+}
+
+static int lcd_close(struct inode *pinode, struct file *pfile)
+{
+    struct lcd_screen *scr = (struct lcd_screen *)pfile->private_data;
+    struct lcd *pdev = scr->pdev;
+    bool changed = false;
+    printk(KERN_INFO "%s : lcd_close is called\n", THIS_MODULE->name);
+
+    // the page work shows this screen, it has to be gone before the screen leaves the list
+    cancel_delayed_work_sync(&scr->page_work);
+    cancel_delayed_work_sync(&scr->anim_work);
+
+    if (!list_empty(&scr->node))
+    {
+        mutex_lock(&pdev->screens_lock);
+        list_del(&scr->node);
+        if (pdev->active == scr)
+        {
+            pdev->active = NULL;
+            changed = lcd_select_screen(pdev);
+        }
+        // the active screen shows again where the lease was
+        if (scr->leased)
+            changed = true;
+        mutex_unlock(&pdev->screens_lock);
+    }
+    // the flush work only reaches screens through the list, this one is gone from it now
+    if (changed)
+        lcd_queue_flush(pdev);
+    lcd_set_eventfd(scr, -1);
+
+    kfree(scr->pages);
+    kfree(scr->anim);
+    mutex_destroy(&scr->lock);
+    kfree(scr);
+    lcd_put(pdev);
+
+    return 0;
+}
+static ssize_t lcd_read(struct file *pfile, char __user *ubuf, size_t size, loff_t *poffset)
+{
+    size_t len, done, seg;
+    loff_t pos = *poffset;
+    struct lcd_screen *scr = (struct lcd_screen *)pfile->private_data;
+    struct lcd *pdev = scr->pdev;
+    struct lcd_region win;
+    printk(KERN_INFO "%s : lcd_read is called\n", THIS_MODULE->name);
+
+    mutex_lock(&scr->lock);
+    win = scr->win;
+    mutex_unlock(&scr->lock);
+
+    // the lcd itself is not read back, the cells are returned from the frame the panel shows
+    if (pos < 0)
+        return -EINVAL;
+    if (pos >= lcd_region_size(&win))
+        return 0;
+    len = min_t(size_t, size, lcd_region_size(&win) - pos);
+
+    mutex_lock(&pdev->frame_lock);
+    for (done = 0; done < len; done += seg)
+    {
+        seg = min_t(size_t, len - done, win.width - (pos + done) % win.width);
+        if (copy_to_user(ubuf + done, pdev->frame + lcd_region_cell(&win, pos + done), seg) != 0)
+        {
+            mutex_unlock(&pdev->frame_lock);
+            return -EFAULT;
+        }
+    }
+    scr->seen_seq = pdev->shown_seq;
+    mutex_unlock(&pdev->frame_lock);
+
+    *poffset = pos + len;
+    return len;
+}
+
+/*
+ * description:		write characters into the cells of this file's screen starting at the file offset.
+ *			Offset row * width + col addresses one cell of the file's window (the whole panel, or the
+ *			region it leased), so pwrite() or lseek() + write() update a single field. The write only
+ *			touches the screen and returns, the flush work sends the changed cells to the lcd.
+ */
+static ssize_t lcd_write(struct file *pfile, const char __user *ubuf, size_t size, loff_t *poffset)
+{
+    ssize_t ret;
+    size_t len, done, seg;
+    loff_t pos = *poffset;
+    struct lcd_screen *scr = (struct lcd_screen *)pfile->private_data;
+    printk(KERN_INFO "%s : lcd_write is called\n", THIS_MODULE->name);
+
+    mutex_lock(&scr->lock);
+    if (scr->mode == LCD_MODE_TERMINAL)
+    {
+        ret = lcd_term_write(scr, ubuf, size);
+        mutex_unlock(&scr->lock);
+        if (ret > 0)
+            lcd_screen_submit(scr);
+        return ret;
+    }
+    if (scr->mode == LCD_MODE_PAGING)
+    {
+        ret = lcd_page_write(scr, ubuf, size);
+        mutex_unlock(&scr->lock);
+        if (ret > 0)
+        {
+            lcd_screen_submit(scr);
+            mod_delayed_work(lcd_wq, &scr->page_work, msecs_to_jiffies(page_ms));
+        }
+        return ret;
+    }
+
+    if (pos < 0 || size == 0 || pos >= lcd_region_size(&scr->win))
+    {
+        mutex_unlock(&scr->lock);
+        if (pos < 0)
+            return -EINVAL;
+        // there is no cell behind the last one of the window
+        return size == 0 ? 0 : -ENOSPC;
+    }
+    len = min_t(size_t, size, lcd_region_size(&scr->win) - pos);
+
+    // copying the user data straight into the screen of this file, one window row at a time
+    for (done = 0; done < len; done += seg)
+    {
+        seg = min_t(size_t, len - done, scr->win.width - (pos + done) % scr->win.width);
+        if (copy_from_user(scr->cells + lcd_region_cell(&scr->win, pos + done), ubuf + done, seg) != 0)
+        {
+            mutex_unlock(&scr->lock);
+            printk(KERN_ERR "%s : bytes not copied from user buffer\n", THIS_MODULE->name);
+            return -EFAULT;
+        }
+    }
+    mutex_unlock(&scr->lock);
+
+    lcd_screen_submit(scr);
+    printk(KERN_INFO "%s : data written into lcd screen %u\n", THIS_MODULE->name, scr->id);
+
+    *poffset = pos + len;
+    return len;
+}
+
+/*
+ * description:		writev() and splice. A writev() of several buffers in cells mode writes buffer i
+ *			into row i of the window, a shorter buffer blanks the rest of its row, so all rows
+ *			of a screen are replaced in one call. Anything else is taken like a write().
+ */
+static ssize_t lcd_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+    struct lcd_screen *scr = (struct lcd_screen *)iocb->ki_filp->private_data;
+    ssize_t ret;
+
+    mutex_lock(&scr->lock);
+    if (scr->mode == LCD_MODE_CELLS && iter_is_iovec(from) && from->nr_segs > 1)
+        ret = lcd_write_rows(scr, from);
+    else
+        ret = lcd_write_stream(scr, iocb, from);
+    mutex_unlock(&scr->lock);
+
+    if (ret > 0)
+        lcd_screen_submit(scr);
+    if (ret > 0 && READ_ONCE(scr->mode) == LCD_MODE_PAGING)
+        mod_delayed_work(lcd_wq, &scr->page_work, msecs_to_jiffies(page_ms));
+    return ret;
+}
+
+// one segment of 'from' per row of the window, segments past the last row are left. Caller holds scr->lock.
+static ssize_t lcd_write_rows(struct lcd_screen *scr, struct iov_iter *from)
+{
+    unsigned int row, cell;
+    size_t seg, n, done = 0;
+    char line[NUM_CHARS_PER_LINE];
+
+    for (row = 0; row < scr->win.height && iov_iter_count(from) != 0; row++)
+    {
+        seg = iov_iter_single_seg_count(from);
+        n = min_t(size_t, seg, scr->win.width);
+        memset(line, ' ', sizeof(line));
+        if (copy_from_iter(line, n, from) != n)
+            return done ? done : -EFAULT;
+        // the part of the segment that does not fit the row is dropped
+        iov_iter_advance(from, seg - n);
+        done += seg;
+
+        cell = lcd_region_cell(&scr->win, row * scr->win.width);
+        memcpy(scr->cells + cell, line, scr->win.width);
+    }
+    return done;
+}
+
+/*
+ * description:		write() semantics of the mode of the screen for data that is not in a user buffer,
+ *			e.g. a pipe spliced into the device. Caller holds scr->lock.
+ */
+static ssize_t lcd_write_stream(struct lcd_screen *scr, struct kiocb *iocb, struct iov_iter *from)
+{
+    size_t size = iov_iter_count(from), len, done, seg, i;
+    unsigned int npages;
+    char buf[64], *text, *pages;
+    loff_t pos = iocb->ki_pos;
+
+    if (size == 0)
+        return 0;
+
+    if (scr->mode == LCD_MODE_TERMINAL)
+    {
+        for (done = 0; done < size; done += seg)
+        {
+            seg = copy_from_iter(buf, min_t(size_t, size - done, sizeof(buf)), from);
+            if (seg == 0)
+                break;
+            for (i = 0; i < seg; i++)
+                lcd_term_putc(scr, buf[i]);
+        }
+        return done ? done : -EFAULT;
+    }
+
+    if (scr->mode == LCD_MODE_PAGING)
+    {
+        if (size > LCD_PAGE_MAX)
+            return -EFBIG;
+        text = kmalloc(size, GFP_KERNEL);
+        if (text == NULL)
+            return -ENOMEM;
+        if (copy_from_iter(text, size, from) != size)
+        {
+            kfree(text);
+            return -EFAULT;
+        }
+        pages = lcd_page_layout(text, size, &scr->win, &npages);
+        kfree(text);
+        if (pages == NULL)
+            return -ENOMEM;
+        lcd_page_set(scr, pages, npages);
+        return size;
+    }
+
+    if (pos < 0)
+        return -EINVAL;
+    if (pos >= lcd_region_size(&scr->win))
+        return -ENOSPC;
+    len = min_t(size_t, size, lcd_region_size(&scr->win) - pos);
+    for (done = 0; done < len; done += seg)
+    {
+        seg = min_t(size_t, len - done, scr->win.width - (pos + done) % scr->win.width);
+        if (copy_from_iter(scr->cells + lcd_region_cell(&scr->win, pos + done), seg, from) != seg)
+            return done ? done : -EFAULT;
+    }
+    iocb->ki_pos = pos + len;
+    return len;
+}
+
+/*
+ * description:		feed a byte stream through the terminal parser of the screen.
+ *			The whole write is parsed before the flush work runs, so intermediate states of
+ *			the stream (e.g. a line that scrolls away again) never reach the bus.
+ *			Caller holds the screen lock.
+ */
+static ssize_t lcd_term_write(struct lcd_screen *scr, const char __user *ubuf, size_t size)
+{
+    size_t i;
+    char c;
+
+    for (i = 0; i < size; i++)
+    {
+        if (get_user(c, ubuf + i) != 0)
+            break;
+        lcd_term_putc(scr, c);
+    }
+
+    if (i == 0 && size != 0)
+        return -EFAULT;
+    return i;
+}
+
+static loff_t lcd_llseek(struct file *pfile, loff_t offset, int whence)
+{
+    struct lcd_screen *scr = (struct lcd_screen *)pfile->private_data;
+
+    // the device is a file with one byte per cell of the window
+    return fixed_size_llseek(pfile, offset, whence, lcd_region_size(&scr->win));
+}
+
+// readable once a frame newer than the last one this file saw (read(), LCD_GET_SEQ) is on the panel
+static __poll_t lcd_poll(struct file *pfile, struct poll_table_struct *wait)
+{
+    struct lcd_screen *scr = (struct lcd_screen *)pfile->private_data;
+    struct lcd *pdev = scr->pdev;
+
+    poll_wait(pfile, &pdev->shown_wq, wait);
+    if (READ_ONCE(pdev->shown_seq) != READ_ONCE(scr->seen_seq))
+        return EPOLLIN | EPOLLRDNORM;
+    return 0;
+}
+
+/*
+ * description:		wait until everything written before the call is on the panel.
+ *			Writes only queue the flush work, fsync() queues one more flush and sleeps until
+ *			it has run, covering the screens of every file, hidden or not.
+ */
+static int lcd_fsync(struct file *pfile, loff_t start, loff_t end, int datasync)
+{
+    struct lcd_screen *scr = (struct lcd_screen *)pfile->private_data;
+    struct lcd *pdev = scr->pdev;
+    unsigned int seq = lcd_queue_flush(pdev);
+
+    return wait_event_interruptible(pdev->shown_wq, lcd_seq_shown(pdev, seq));
+}
+
+static long lcd_ioctl(struct file *pfile, unsigned cmd, unsigned long param)
+{
+    unsigned int i;
+    struct lcd_region region;
+    struct lcd_snapshot snap;
+    struct lcd_seq seq;
+    struct lcd_widget_req wreq;
+    struct lcd_bus_stats stats;
+    struct lcd_anim anim;
+    struct lcd_timing t;
+    struct lcd_screen *scr = (struct lcd_screen *)pfile->private_data;
+    struct lcd *pdev = scr->pdev;
+    int ret;
+
+    switch (cmd)
+    {
+    case LCD_CLEAR_IOCTL:
+        mutex_lock(&scr->lock);
+        lcd_screen_clear(scr);
+        mutex_unlock(&scr->lock);
+        lcd_screen_submit(scr);
+        printk(KERN_INFO "lcd_ioctl : lcd_clear is called\n");
+        break;
+    case LCD_SET_MODE:
+        if (param != LCD_MODE_CELLS && param != LCD_MODE_TERMINAL && param != LCD_MODE_PAGING)
+            return -EINVAL;
+        mutex_lock(&scr->lock);
+        scr->mode = (int)param;
+        lcd_term_reset(&scr->term);
+        lcd_page_drop(scr);
+        mutex_unlock(&scr->lock);
+        printk(KERN_INFO "lcd_ioctl : lcd mode set to %d\n", scr->mode);
+        break;
+    case LCD_GET_SCREEN:
+        return put_user((int)scr->id, (int __user *)param);
+    case LCD_GET_SNAPSHOT:
+        // frame and the sequence number from one moment, the panel itself is not read
+        mutex_lock(&pdev->frame_lock);
+        snap.seq = pdev->frame_seq;
+        memcpy(snap.cells, pdev->frame, LCD_CELLS);
+        mutex_unlock(&pdev->frame_lock);
+        return copy_to_user((void __user *)param, &snap, sizeof(snap)) ? -EFAULT : 0;
+    case LCD_GET_SEQ:
+        seq.submitted = atomic_read(&pdev->submit_seq);
+        mutex_lock(&pdev->frame_lock);
+        seq.shown = pdev->shown_seq;
+        scr->seen_seq = seq.shown;
+        mutex_unlock(&pdev->frame_lock);
+        return copy_to_user((void __user *)param, &seq, sizeof(seq)) ? -EFAULT : 0;
+    case LCD_SET_EVENTFD:
+        return lcd_set_eventfd(scr, (int)param);
+    case LCD_ADD_WIDGET:
+        if (copy_from_user(&wreq, (void __user *)param, sizeof(wreq)) != 0)
+            return -EFAULT;
+        return lcd_add_widget(pdev, &wreq);
+    case LCD_DEL_WIDGET:
+        return lcd_del_widget(pdev, (unsigned int)param);
+    case LCD_SET_ANIMATION:
+        if (copy_from_user(&anim, (void __user *)param, sizeof(anim)) != 0)
+            return -EFAULT;
+        return lcd_set_animation(scr, &anim);
+    case LCD_SET_MIRROR:
+        return lcd_set_mirror(pdev, (unsigned int)param);
+    case LCD_CALIBRATE:
+        ret = lcd_recalibrate(pdev, &t);
+        if (ret != 0)
+            return ret;
+        return copy_to_user((void __user *)param, &t, sizeof(t)) ? -EFAULT : 0;
+    case LCD_GET_BUS_STATS:
+        mutex_lock(&bus_lock);
+        stats = bus_stats;
+        mutex_unlock(&bus_lock);
+        return copy_to_user((void __user *)param, &stats, sizeof(stats)) ? -EFAULT : 0;
+    case LCD_SET_REGION:
+        if (copy_from_user(&region, (void __user *)param, sizeof(region)) != 0)
+            return -EFAULT;
+        return lcd_set_region(scr, &region);
+    case LCD_SHOW_SCREEN:
+        return lcd_show_screen(pdev, (unsigned int)param);
+    case LCD_SET_POLICY:
+        return lcd_set_policy(pdev, (int)param);
+    case LCD_SET_TTL:
+        WRITE_ONCE(scr->ttl_ms, (unsigned int)param);
+        break;
+    case LCD_SET_PRIORITY:
+        mutex_lock(&pdev->screens_lock);
+        scr->prio = (int)param;
+        i = lcd_select_screen(pdev);
+        mutex_unlock(&pdev->screens_lock);
+        if (i)
+            lcd_queue_flush(pdev);
+        break;
+    case LCD_SET_PAGE_FLIP:
+        // lock order is always frame_lock then bus_lock
+        mutex_lock(&pdev->frame_lock);
+        mutex_lock(&bus_lock);
+        // the panels of a mirror group all draw in place
+        if (param != 0 && pdev->mirror != 0)
+        {
+            mutex_unlock(&bus_lock);
+            mutex_unlock(&pdev->frame_lock);
+            return -EBUSY;
+        }
+        lcd_bus_select(pdev, 0);
+        pdev->page_flip = (param != 0);
+        if (!pdev->page_flip)
+        {
+            // back to drawing in place, page 0 has to hold the frame before it is shown
+            lcd_flush_page(pdev, 0, 0, LCD_CELLS);
+            lcd_present(pdev, 0);
+        }
+        mutex_unlock(&bus_lock);
+        mutex_unlock(&pdev->frame_lock);
+        printk(KERN_INFO "lcd_ioctl : lcd page flip %s\n", param ? "on" : "off");
+        break;
+    case LCD_SHIFT_LEFT:
+        // LCD_DDRAM_COLS shifts are a full turn, a huge count must not hold bus_lock for hours
+        i = (unsigned int)param % LCD_DDRAM_COLS;
+        printk(KERN_INFO "lcd_ioctl : lcd_shift_left is called\n");
+        mutex_lock(&pdev->frame_lock);
+        mutex_lock(&bus_lock);
+        // a mirror group shifts as a whole
+        lcd_bus_select(pdev, 1);
+        lcd_mirror_prepare(pdev);
+        while (i>0)
+        {
+            lcd_shift_left();
+            pdev->shift = (pdev->shift + 1) % LCD_DDRAM_COLS;
+            i--;
+        }     
+        lcd_mirror_update(pdev);
+        mutex_unlock(&bus_lock);
+        mutex_unlock(&pdev->frame_lock);
+        break;
+    case LCD_SHIFT_RIGHT:
+        i = (unsigned int)param % LCD_DDRAM_COLS;
+        printk(KERN_INFO "lcd_ioctl : lcd_shift_right is called\n");
+        mutex_lock(&pdev->frame_lock);
+        mutex_lock(&bus_lock);
+        lcd_bus_select(pdev, 1);
+        lcd_mirror_prepare(pdev);
+        while (i>0)
+        {
+            lcd_shift_right();
+            pdev->shift = (pdev->shift + LCD_DDRAM_COLS - 1) % LCD_DDRAM_COLS;
+            i--;
+        }
+        lcd_mirror_update(pdev);
+        mutex_unlock(&bus_lock);
+        mutex_unlock(&pdev->frame_lock);
+        break;
+    default:
+        printk(KERN_INFO "%s : Invaild cmd\n", THIS_MODULE->name);
+        return -EINVAL;
+        break;
+    }
+    return 0;
+}
+
+/*
+ * description:		pick the screen to composite according to the selection policy.
+ *			Caller holds screens_lock.
+ * @return		1 when the active screen changed
+ */
+static int lcd_select_screen(struct lcd *pdev)
+{
+    struct lcd_screen *scr, *best = pdev->active;
+
+    switch (pdev->policy)
+    {
+    case LCD_SELECT_PRIORITY:
+        best = NULL;
+        list_for_each_entry(scr, &pdev->screens, node)
+        {
+            if (scr->leased || !lcd_screen_live(scr))
+                continue;
+            if (best == NULL || scr->prio > best->prio || (scr->prio == best->prio && scr->stamp > best->stamp))
+                best = scr;
+        }
+        break;
+    case LCD_SELECT_ROUND_ROBIN:
+        if (best == NULL || !lcd_screen_live(best))
+            best = lcd_next_screen(pdev, best);
+        break;
+    default:
+        // LCD_SELECT_LATEST and LCD_SELECT_MANUAL keep the last frame when the active screen goes away.
+        // An expired one hands the panel back to the newest screen it preempted.
+        if (best != NULL && !lcd_screen_live(best))
+            best = lcd_newest_screen(pdev);
+        break;
+    }
+
+    // nothing left that still matters, the expired text is not kept on the panel either
+    if (best == NULL && pdev->active != NULL && !lcd_screen_live(pdev->active))
+        pdev->blank = true;
+    if (best == pdev->active)
+        return 0;
+    pdev->active = best;
+    return 1;
+}
+
+// a writer changed 'scr', show it if the policy says so and flush it when it is on the panel
+static void lcd_screen_changed(struct lcd_screen *scr)
+{
+    struct lcd *pdev = scr->pdev;
+    bool shown;
+
+    // a lease is always on the panel and nobody else draws there, no device wide lock needed
+    if (READ_ONCE(scr->leased))
+    {
+        lcd_queue_flush(pdev);
+        return;
+    }
+
+    mutex_lock(&pdev->screens_lock);
+    scr->stamp = ++pdev->write_seq;
+    if (pdev->policy == LCD_SELECT_LATEST)
+    {
+        // the page and animation works keep changing a screen after it expired
+        if (lcd_screen_live(scr))
+            pdev->active = scr;
+    }
+    else
+        lcd_select_screen(pdev);
+    shown = (pdev->active == scr);
+    mutex_unlock(&pdev->screens_lock);
+
+    if (shown)
+        lcd_queue_flush(pdev);
+}
+
+/*
+ * description:		a new message from the owner of the screen, its time to live starts over.
+ *			Writes, clears and the like come through here, the works that redraw a screen
+ *			by themselves (pages, animations) call lcd_screen_changed() and do not extend it.
+ */
+static void lcd_screen_submit(struct lcd_screen *scr)
+{
+    struct lcd *pdev = scr->pdev;
+    unsigned int ttl_ms = READ_ONCE(scr->ttl_ms);
+    unsigned long expires;
+
+    if (ttl_ms != 0 && !READ_ONCE(scr->leased))
+    {
+        expires = jiffies + msecs_to_jiffies(ttl_ms);
+        if (expires == 0)
+            expires = 1;    // 0 is never
+        mutex_lock(&pdev->screens_lock);
+        scr->expires = expires;
+        if (pdev->next_expiry == 0 || time_before(expires, pdev->next_expiry))
+        {
+            pdev->next_expiry = expires;
+            mod_delayed_work(lcd_wq, &pdev->expire_work, msecs_to_jiffies(ttl_ms));
+        }
+        mutex_unlock(&pdev->screens_lock);
+    }
+    else if (READ_ONCE(scr->expires) != 0)
+    {
+        mutex_lock(&pdev->screens_lock);
+        scr->expires = 0;
+        mutex_unlock(&pdev->screens_lock);
+    }
+    lcd_screen_changed(scr);
+}
+
+// whether what was last written to the screen still matters. Caller holds screens_lock.
+static int lcd_screen_live(struct lcd_screen *scr)
+{
+    return scr->expires == 0 || time_before(jiffies, scr->expires);
+}
+
+// most recently written screen that has not expired. Caller holds screens_lock.
+static struct lcd_screen *lcd_newest_screen(struct lcd *pdev)
+{
+    struct lcd_screen *scr, *best = NULL;
+
+    list_for_each_entry(scr, &pdev->screens, node)
+    {
+        if (scr->leased || scr->stamp == 0 || !lcd_screen_live(scr))
+            continue;
+        if (best == NULL || scr->stamp > best->stamp)
+            best = scr;
+    }
+    return best;
+}
+
+/*
+ * description:		a screen reached the end of its time to live. The selection runs again without
+ *			it, so whatever it preempted comes back from its screen at the next frame, and a
+ *			message that expired while waiting behind a more important one never reaches the bus.
+ */
+static void lcd_expire_work(struct work_struct *work)
+{
+    struct lcd *pdev = container_of(to_delayed_work(work), struct lcd, expire_work);
+    struct lcd_screen *scr;
+    unsigned long next = 0;
+    bool changed;
+
+    mutex_lock(&pdev->screens_lock);
+    changed = lcd_select_screen(pdev);
+    list_for_each_entry(scr, &pdev->screens, node)
+    {
+        if (scr->expires != 0 && lcd_screen_live(scr) && (next == 0 || time_before(scr->expires, next)))
+            next = scr->expires;
+    }
+    pdev->next_expiry = next;
+    if (next != 0)
+        queue_delayed_work(lcd_wq, &pdev->expire_work, time_after(next, jiffies) ? next - jiffies : 0);
+    mutex_unlock(&pdev->screens_lock);
+
+    if (changed)
+        lcd_queue_flush(pdev);
+}
+
+static int lcd_show_screen(struct lcd *pdev, unsigned int id)
+{
+    struct lcd_screen *scr;
+    int ret = -ENOENT;
+
+    mutex_lock(&pdev->screens_lock);
+    list_for_each_entry(scr, &pdev->screens, node)
+    {
+        if (scr->id == id && !scr->leased)
+        {
+            pdev->active = scr;
+            ret = 0;
+            break;
+        }
+    }
+    mutex_unlock(&pdev->screens_lock);
+
+    if (ret == 0)
+        lcd_queue_flush(pdev);
+    return ret;
+}
+
+static int lcd_set_policy(struct lcd *pdev, int policy)
+{
+    bool changed;
+
+    if (policy < LCD_SELECT_LATEST || policy > LCD_SELECT_PRIORITY)
+        return -EINVAL;
+
+    mutex_lock(&pdev->screens_lock);
+    pdev->policy = policy;
+    changed = lcd_select_screen(pdev);
+    mutex_unlock(&pdev->screens_lock);
+
+    if (changed)
+        lcd_queue_flush(pdev);
+    if (policy == LCD_SELECT_ROUND_ROBIN)
+        mod_delayed_work(lcd_wq, &pdev->rotate_work, msecs_to_jiffies(rotate_ms));
+    else
+        cancel_delayed_work_sync(&pdev->rotate_work);
+
+    printk(KERN_INFO "%s : screen selection policy set to %d\n", THIS_MODULE->name, policy);
+    return 0;
+}
+
+// screen after 'scr' in the list that is not a region lease, wrapping around. Caller holds screens_lock.
+static struct lcd_screen *lcd_next_screen(struct lcd *pdev, struct lcd_screen *scr)
+{
+    struct lcd_screen *next;
+    struct list_head *pos = scr ? &scr->node : &pdev->screens;
+    unsigned int n = 0;
+
+    list_for_each_entry(next, &pdev->screens, node)
+        n++;
+
+    // at most one full round through the list
+    while (n-- > 0)
+    {
+        pos = pos->next;
+        if (pos == &pdev->screens)
+            pos = pos->next;
+        next = list_entry(pos, struct lcd_screen, node);
+        if (!next->leased && lcd_screen_live(next))
+            return next;
+    }
+    return NULL;
+}
+
+// the region has cells and lies on the panel
+static int lcd_region_valid(const struct lcd_region *win)
+{
+    return win->width > 0 && win->height > 0 && win->row < NUM_LINES && win->col < NUM_CHARS_PER_LINE &&
+           win->height <= NUM_LINES - win->row && win->width <= NUM_CHARS_PER_LINE - win->col;
+}
+
+static int lcd_region_overlap(const struct lcd_region *a, const struct lcd_region *b)
+{
+    return a->row < b->row + b->height && b->row < a->row + a->height &&
+           a->col < b->col + b->width && b->col < a->col + a->width;
+}
+
+// 'win' overlaps a region lease other than the one of 'self' or a widget. Caller holds screens_lock.
+static int lcd_region_busy(struct lcd *pdev, const struct lcd_region *win, struct lcd_screen *self)
+{
+    struct lcd_screen *scr;
+    struct lcd_widget *w;
+    int busy = 0;
+
+    list_for_each_entry(scr, &pdev->screens, node)
+    {
+        if (scr != self && scr->leased && lcd_region_overlap(win, &scr->win))
+            return 1;
+    }
+    mutex_lock(&pdev->widgets_lock);
+    list_for_each_entry(w, &pdev->widgets, node)
+    {
+        if (lcd_region_overlap(win, &w->win))
+        {
+            busy = 1;
+            break;
+        }
+    }
+    mutex_unlock(&pdev->widgets_lock);
+    return busy;
+}
+
+/*
+ * description:		lease a rectangle of the panel to the screen of one file.
+ *			Writes of the file are then positioned within and clipped to the rectangle, and the
+ *			compositor puts its cells on top of the active screen. Leases must not overlap.
+ *			A width or height of 0 gives the lease back.
+ */
+static int lcd_set_region(struct lcd_screen *scr, const struct lcd_region *region)
+{
+    struct lcd *pdev = scr->pdev;
+    bool release = (region->width == 0 || region->height == 0);
+
+    if (list_empty(&scr->node))
+        return -EBADF; // files opened read only have no screen on the panel
+    if (!release && !lcd_region_valid(region))
+        return -EINVAL;
+
+    mutex_lock(&pdev->screens_lock);
+    if (!release && lcd_region_busy(pdev, region, scr))
+    {
+        mutex_unlock(&pdev->screens_lock);
+        return -EBUSY;
+    }
+
+    mutex_lock(&scr->lock);
+    scr->leased = !release;
+    if (release)
+    {
+        scr->win.row = 0;
+        scr->win.col = 0;
+        scr->win.width = NUM_CHARS_PER_LINE;
+        scr->win.height = NUM_LINES;
+    }
+    else
+    {
+        scr->win = *region;
+    }
+    lcd_term_reset(&scr->term);
+    lcd_page_drop(scr); // laid out for the old window
+    lcd_anim_drop(scr);
+    mutex_unlock(&scr->lock);
+
+    // a leased screen is not selectable any more
+    if (pdev->active == scr)
+    {
+        pdev->active = NULL;
+        lcd_select_screen(pdev);
+    }
+    mutex_unlock(&pdev->screens_lock);
+
+    lcd_queue_flush(pdev);
+    printk(KERN_INFO "%s : screen %u region %ux%u at %u,%u\n", THIS_MODULE->name, scr->id,
+           scr->win.width, scr->win.height, scr->win.row, scr->win.col);
+    return 0;
+}
+
+/*
+ * description:		put the text of widget 'w' into its cells, row by row through the region,
+ *			padded with blanks and cut at the end of the region.
+ *			Returns 1 if the cells changed. Caller holds widgets_lock.
+ */
+static int lcd_widget_render(struct lcd_widget *w)
+{
+    char text[LCD_CELLS + 1];
+    struct tm tm;
+    unsigned long up, load;
+    unsigned int i, n, cell;
+    int changed = 0;
+
+    text[0] = '\0';
+    switch (w->type)
+    {
+    case LCD_WIDGET_CLOCK:
+        time64_to_tm(ktime_get_real_seconds(), -sys_tz.tz_minuteswest * 60, &tm);
+        snprintf(text, sizeof(text), "%02d:%02d:%02d", tm.tm_hour, tm.tm_min, tm.tm_sec);
+        break;
+    case LCD_WIDGET_UPTIME:
+        up = ktime_get_boottime_seconds();
+        if (up >= 86400)
+            snprintf(text, sizeof(text), "up %lud %02lu:%02lu", up / 86400, up / 3600 % 24, up / 60 % 60);
+        else
+            snprintf(text, sizeof(text), "up %02lu:%02lu:%02lu", up / 3600, up / 60 % 60, up % 60);
+        break;
+    case LCD_WIDGET_LOADAVG:
+        // rounded like /proc/loadavg
+        load = avenrun[0] + (FIXED_1 / 200);
+        snprintf(text, sizeof(text), "%lu.%02lu", LOAD_INT(load), LOAD_FRAC(load));
+        break;
+    case LCD_WIDGET_FILE:
+        memcpy(text, w->text, sizeof(text));
+        break;
+    }
+
+    n = strlen(text);
+    for (i = 0; i < lcd_region_size(&w->win); i++)
+    {
+        cell = lcd_region_cell(&w->win, i);
+        if (w->cells[cell] != (i < n ? text[i] : ' '))
+        {
+            w->cells[cell] = i < n ? text[i] : ' ';
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+// first line of a widget file into 'text', "?" when it cannot be read
+static void lcd_widget_read(const struct path *file, char *text)
+{
+    struct file *f;
+    loff_t off = 0;
+    ssize_t len;
+
+    f = dentry_open(file, O_RDONLY, current_cred());
+    if (IS_ERR(f))
+    {
+        snprintf(text, LCD_CELLS + 1, "?");
+        return;
+    }
+    len = kernel_read(f, text, LCD_CELLS, &off);
+    filp_close(f, NULL);
+    text[len > 0 ? len : 0] = '\0';
+    // the first line only
+    text[strcspn(text, "\n")] = '\0';
+}
+
+/*
+ * description:		reads the files of the widgets every widget_ms, then has them rendered on lcd_wq.
+ *			Runs on system_wq without widgets_lock, a slow file must not hold up the flushes
+ *			of the ordered lcd_wq. Widget ids only grow along the list, so the walk picks up
+ *			after the last widget read even if others were added or deleted meanwhile.
+ */
+static void lcd_widget_work(struct work_struct *work)
+{
+    struct lcd *pdev = container_of(to_delayed_work(work), struct lcd, widget_work);
+    struct lcd_widget *w;
+    struct path file;
+    char text[LCD_CELLS + 1];
+    unsigned int id = 0;
+    bool found;
+    int any;
+
+    for (;;)
+    {
+        found = false;
+        mutex_lock(&pdev->widgets_lock);
+        list_for_each_entry(w, &pdev->widgets, node)
+        {
+            if (w->type == LCD_WIDGET_FILE && w->id > id)
+            {
+                id = w->id;
+                file = w->file;
+                path_get(&file);
+                found = true;
+                break;
+            }
+        }
+        mutex_unlock(&pdev->widgets_lock);
+        if (!found)
+            break;
+
+        lcd_widget_read(&file, text);
+        path_put(&file);
+
+        mutex_lock(&pdev->widgets_lock);
+        list_for_each_entry(w, &pdev->widgets, node)
+        {
+            if (w->id == id)
+            {
+                memcpy(w->text, text, sizeof(text));
+                break;
+            }
+        }
+        mutex_unlock(&pdev->widgets_lock);
+    }
+
+    mutex_lock(&pdev->widgets_lock);
+    any = !list_empty(&pdev->widgets);
+    mutex_unlock(&pdev->widgets_lock);
+
+    queue_work(lcd_wq, &pdev->widget_render_work);
+    if (any)
+        queue_delayed_work(system_wq, &pdev->widget_work, msecs_to_jiffies(widget_ms));
+}
+
+// refreshes every widget of the panel and flushes the ones that changed
+static void lcd_widget_render_work(struct work_struct *work)
+{
+    struct lcd *pdev = container_of(work, struct lcd, widget_render_work);
+    struct lcd_widget *w;
+    int changed = 0;
+
+    mutex_lock(&pdev->widgets_lock);
+    list_for_each_entry(w, &pdev->widgets, node)
+        changed |= lcd_widget_render(w);
+    mutex_unlock(&pdev->widgets_lock);
+
+    // the flush only sends the characters that differ from what the lcd holds
+    if (changed)
+        lcd_queue_flush(pdev);
+}
+
+/*
+ * description:		bind a widget to a region of the panel, returns its id.
+ *			Widgets belong to the device, not to the file that added them, and stay until
+ *			LCD_DEL_WIDGET. The region must not overlap a lease or another widget.
+ */
+static int lcd_add_widget(struct lcd *pdev, struct lcd_widget_req *req)
+{
+    struct lcd_widget *w;
+    struct path file;
+    unsigned long magic;
+    int id, ret;
+
+    if (!lcd_region_valid(&req->win) || req->type < LCD_WIDGET_CLOCK || req->type > LCD_WIDGET_FILE)
+        return -EINVAL;
+    if (req->type == LCD_WIDGET_FILE)
+    {
+        // the module reads the file with its own rights and the text can be read back from the device
+        if (!capable(CAP_SYS_ADMIN))
+            return -EPERM;
+        req->path[LCD_WIDGET_PATH - 1] = '\0';
+        // resolved here, "..", symlinks and other mounts cannot lead the check anywhere else
+        ret = kern_path(req->path, LOOKUP_FOLLOW, &file);
+        if (ret != 0)
+            return ret;
+        magic = file.dentry->d_sb->s_magic;
+        if (magic != SYSFS_MAGIC && magic != PROC_SUPER_MAGIC)
+        {
+            path_put(&file);
+            return -EINVAL;
+        }
+    }
+
+    w = kzalloc(sizeof(*w), GFP_KERNEL);
+    if (w == NULL)
+    {
+        if (req->type == LCD_WIDGET_FILE)
+            path_put(&file);
+        return -ENOMEM;
+    }
+    w->type = req->type;
+    w->win = req->win;
+    // the widget keeps the file it was checked against, it is not looked up again
+    if (w->type == LCD_WIDGET_FILE)
+        w->file = file;
+    memset(w->cells, ' ', LCD_CELLS);
+
+    mutex_lock(&pdev->screens_lock);
+    if (lcd_region_busy(pdev, &w->win, NULL))
+    {
+        mutex_unlock(&pdev->screens_lock);
+        lcd_widget_free(w);
+        return -EBUSY;
+    }
+    mutex_lock(&pdev->widgets_lock);
+    id = w->id = ++pdev->next_widget;
+    list_add_tail(&w->node, &pdev->widgets);
+    mutex_unlock(&pdev->widgets_lock);
+    mutex_unlock(&pdev->screens_lock);
+
+    // read and rendered right away, then every widget_ms
+    mod_delayed_work(system_wq, &pdev->widget_work, 0);
+    printk(KERN_INFO "%s : widget %d type %d at %u,%u\n", THIS_MODULE->name, id, w->type, w->win.row, w->win.col);
+    return id;
+}
+
+static int lcd_del_widget(struct lcd *pdev, unsigned int id)
+{
+    struct lcd_widget *w;
+    int ret = -ENOENT;
+
+    mutex_lock(&pdev->widgets_lock);
+    list_for_each_entry(w, &pdev->widgets, node)
+    {
+        if (w->id == id)
+        {
+            list_del(&w->node);
+            lcd_widget_free(w);
+            ret = 0;
+            break;
+        }
+    }
+    mutex_unlock(&pdev->widgets_lock);
+
+    // the screens underneath show again
+    if (ret == 0)
+        lcd_queue_flush(pdev);
+    return ret;
+}
+
+static void lcd_widget_free(struct lcd_widget *w)
+{
+    if (w->type == LCD_WIDGET_FILE)
+        path_put(&w->file);
+    kfree(w);
+}
+
+static void lcd_widgets_free(struct lcd *pdev)
+{
+    struct lcd_widget *w, *tmp;
+
+    list_for_each_entry_safe(w, tmp, &pdev->widgets, node)
+    {
+        list_del(&w->node);
+        lcd_widget_free(w);
+    }
+}
+
+/*
+ * description:		lay 'text' out into pages of the window 'win', breaking lines at word boundaries.
+ *			A word longer than a line is split, '\n' starts a new line, blanks at the start of a
+ *			line are dropped. Returns the pages, win->height lines of win->width cells each,
+ *			NULL without memory.
+ */
+static char *lcd_page_layout(const char *text, size_t len, const struct lcd_region *win, unsigned int *npages)
+{
+    unsigned int w = win->width, h = win->height;
+    unsigned int lines, line, n, brk;
+    size_t pos;
+    char *pages = NULL;
+    int pass;
+
+    // the first pass counts the lines, the second one fills them in
+    for (pass = 0; pass < 2; pass++)
+    {
+        line = 0;
+        pos = 0;
+        while (pos < len)
+        {
+            while (pos < len && text[pos] == ' ')
+                pos++;
+            if (pos == len)
+                break;
+
+            // up to w characters, cut back to the last blank if a word would be split
+            for (n = 0; n < w && pos + n < len && text[pos + n] != '\n'; n++)
+                ;
+            brk = n;
+            if (n == w && pos + n < len && text[pos + n] != ' ' && text[pos + n] != '\n')
+            {
+                while (brk > 0 && text[pos + brk - 1] != ' ')
+                    brk--;
+                if (brk == 0)
+                    brk = n;
+            }
+            if (pages != NULL)
+                memcpy(pages + line * w, text + pos, brk);
+            line++;
+            pos += brk;
+            if (pos < len && text[pos] == '\n')
+                pos++;
+        }
+
+        if (pages != NULL)
+            break;
+        lines = line ? line : 1;
+        *npages = DIV_ROUND_UP(lines, h);
+        pages = kmalloc(*npages * h * w, GFP_KERNEL);
+        if (pages == NULL)
+            return NULL;
+        memset(pages, ' ', *npages * h * w);
+    }
+    return pages;
+}
+
+// put page 'page' into the window of the screen. Caller holds scr->lock.
+static void lcd_page_show(struct lcd_screen *scr, unsigned int page)
+{
+    unsigned int i, size = lcd_region_size(&scr->win);
+
+    scr->page = page;
+    for (i = 0; i < scr->win.height; i++)
+        memcpy(scr->cells + lcd_region_cell(&scr->win, i * scr->win.width),
+               scr->pages + page * size + i * scr->win.width, scr->win.width);
+}
+
+// forget the message, the page work stops on its own. Caller holds scr->lock.
+static void lcd_page_drop(struct lcd_screen *scr)
+{
+    kfree(scr->pages);
+    scr->pages = NULL;
+    scr->npages = 0;
+}
+
+/*
+ * description:		LCD_MODE_PAGING write, the whole message is taken in one call and replaces the last one.
+ *			It is laid out into pages of the window and the first page is shown, the page work
+ *			shows the following ones. Caller holds scr->lock.
+ */
+static ssize_t lcd_page_write(struct lcd_screen *scr, const char __user *ubuf, size_t size)
+{
+    unsigned int npages;
+    char *text, *pages;
+
+    if (size == 0)
+        return 0;
+    if (size > LCD_PAGE_MAX)
+        return -EFBIG;
+
+    text = memdup_user(ubuf, size);
+    if (IS_ERR(text))
+        return PTR_ERR(text);
+    pages = lcd_page_layout(text, size, &scr->win, &npages);
+    kfree(text);
+    if (pages == NULL)
+        return -ENOMEM;
+    lcd_page_set(scr, pages, npages);
+    return size;
+}
+
+// show a message laid out by lcd_page_layout() from its first page on. Caller holds scr->lock.
+static void lcd_page_set(struct lcd_screen *scr, char *pages, unsigned int npages)
+{
+
+    lcd_page_drop(scr);
+    scr->pages = pages;
+    scr->npages = npages;
+    lcd_page_show(scr, 0);
+}
+
+// shows the next page of the message, the flush only sends the cells that differ between the pages
+static void lcd_page_work(struct work_struct *work)
+{
+    struct lcd_screen *scr = container_of(to_delayed_work(work), struct lcd_screen, page_work);
+    bool more;
+
+    mutex_lock(&scr->lock);
+    more = (scr->npages > 1);
+    if (more)
+        lcd_page_show(scr, (scr->page + 1) % scr->npages);
+    mutex_unlock(&scr->lock);
+
+    if (!more)
+        return;
+    lcd_screen_changed(scr);
+    queue_delayed_work(lcd_wq, &scr->page_work, msecs_to_jiffies(page_ms));
+}
+
+// put step 'pos' of the animation into the window. Caller holds scr->lock.
+static void lcd_anim_show(struct lcd_screen *scr, unsigned int pos)
+{
+    const struct lcd_anim_frame *f = &scr->anim[pos];
+    unsigned int i;
+
+    scr->anim_pos = pos;
+    for (i = 0; i < f->len; i++)
+        scr->cells[lcd_region_cell(&scr->win, f->first + i)] = f->cells[i];
+}
+
+// stop the animation, the anim work stops on its own. Caller holds scr->lock.
+static void lcd_anim_drop(struct lcd_screen *scr)
+{
+    kfree(scr->anim);
+    scr->anim = NULL;
+    scr->anim_n = 0;
+}
+
+/*
+ * description:		LCD_SET_ANIMATION, replace the animation of the screen and show its first step.
+ *			The steps are played by the anim work through the diff flush, so every step only
+ *			costs the cells it changes.
+ */
+static int lcd_set_animation(struct lcd_screen *scr, const struct lcd_anim *req)
+{
+    struct lcd_anim_frame *frames = NULL;
+    unsigned int i;
+
+    if (req->nframes > LCD_ANIM_MAX_FRAMES)
+        return -EINVAL;
+    if (req->nframes != 0)
+    {
+        frames = kmalloc_array(req->nframes, sizeof(*frames), GFP_KERNEL);
+        if (frames == NULL)
+            return -ENOMEM;
+        if (copy_from_user(frames, (void __user *)req->frames, req->nframes * sizeof(*frames)) != 0)
+        {
+            kfree(frames);
+            return -EFAULT;
+        }
+    }
+
+    mutex_lock(&scr->lock);
+    for (i = 0; i < req->nframes; i++)
+    {
+        if (frames[i].len > BUF_SIZE || frames[i].first > lcd_region_size(&scr->win) ||
+            frames[i].len > lcd_region_size(&scr->win) - frames[i].first)
+        {
+            mutex_unlock(&scr->lock);
+            kfree(frames);
+            return -EINVAL;
+        }
+    }
+    lcd_anim_drop(scr);
+    if (frames != NULL)
+    {
+        scr->anim = frames;
+        scr->anim_n = req->nframes;
+        scr->anim_loop = (req->loop != 0);
+        lcd_anim_show(scr, 0);
+        scr->anim_next = jiffies + msecs_to_jiffies(frames[0].ms);
+    }
+    mutex_unlock(&scr->lock);
+
+    if (frames == NULL)
+        return 0;
+    lcd_screen_submit(scr);
+    mod_delayed_work(lcd_wq, &scr->anim_work, msecs_to_jiffies(frames[0].ms));
+    return 0;
+}
+
+/*
+ * description:		show the next step of the animation.
+ *			Steps are due at absolute times, the start plus the durations of the steps before,
+ *			so a late flush or a busy bus delays one step and not all the following ones.
+ */
+static void lcd_anim_work(struct work_struct *work)
+{
+    struct lcd_screen *scr = container_of(to_delayed_work(work), struct lcd_screen, anim_work);
+    unsigned long delay = 0;
+    unsigned int pos;
+    bool more = false;
+
+    mutex_lock(&scr->lock);
+    if (scr->anim != NULL)
+    {
+        pos = scr->anim_pos + 1;
+        if (pos == scr->anim_n && scr->anim_loop)
+            pos = 0;
+        if (pos < scr->anim_n)
+        {
+            lcd_anim_show(scr, pos);
+            scr->anim_next += msecs_to_jiffies(scr->anim[pos].ms);
+            if (time_after(scr->anim_next, jiffies))
+                delay = scr->anim_next - jiffies;
+            more = true;
+        }
+    }
+    mutex_unlock(&scr->lock);
+
+    if (!more)
+        return;
+    lcd_screen_changed(scr);
+    queue_delayed_work(lcd_wq, &scr->anim_work, delay);
+}
+
+// LCD_SELECT_ROUND_ROBIN, moves on to the next screen every rotate_ms
+static void lcd_rotate_work(struct work_struct *work)
+{
+    struct lcd *pdev = container_of(to_delayed_work(work), struct lcd, rotate_work);
+    struct lcd_screen *next;
+    bool changed = false;
+
+    mutex_lock(&pdev->screens_lock);
+    if (pdev->policy != LCD_SELECT_ROUND_ROBIN)
+    {
+        mutex_unlock(&pdev->screens_lock);
+        return;
+    }
+    next = lcd_next_screen(pdev, pdev->active);
+    if (next != NULL)
+    {
+        changed = (next != pdev->active);
+        pdev->active = next;
+    }
+    mutex_unlock(&pdev->screens_lock);
+
+    if (changed)
+        lcd_queue_flush(pdev);
+    queue_delayed_work(lcd_wq, &pdev->rotate_work, msecs_to_jiffies(rotate_ms));
+}
+
+/*
+ * description:		compositor, copies the active screen into the frame and sends what changed.
+ *			Switching screens therefore only costs the cells in which the two screens differ.
+ *			The other members of a mirror group do not composite, the flush of their leader
+ *			hands them the frame it sent.
+ */
+static void lcd_flush_work(struct work_struct *work)
+{
+    struct lcd *pdev = container_of(work, struct lcd, flush_work);
+    struct lcd *members[LCD_MAX_EN];
+    struct lcd_screen *scr;
+    struct lcd_widget *w;
+    unsigned int i, cell, member_cnt = 0;
+    unsigned int row = 0, col = NUM_CHARS_PER_LINE;
+    unsigned int seq;
+    bool advanced;
+    char old[LCD_CELLS];
+
+    mutex_lock(&pdev->frame_lock);
+    mutex_lock(&bus_lock);
+    // whatever a panel released before still shows goes with one clear
+    if (pdev->stale)
+    {
+        lcd_bus_select(pdev, 0);
+        lcd_blank(pdev);
+        pdev->stale = false;
+    }
+    // a follower shows what its leader sends, the leader's flush covers what was submitted here
+    if (lcd_mirror_leader(pdev) != pdev)
+    {
+        lcd_queue_flush(lcd_mirror_leader(pdev));
+        mutex_unlock(&bus_lock);
+        mutex_unlock(&pdev->frame_lock);
+        return;
+    }
+    mutex_unlock(&bus_lock);
+
+    // everything submitted up to here is in the screens the compositor is about to read
+    seq = atomic_read(&pdev->submit_seq);
+    memcpy(old, pdev->frame, LCD_CELLS);
+    mutex_lock(&pdev->screens_lock);
+    // without an active screen the frame keeps what was shown last, unless that expired
+    scr = pdev->active;
+    if (scr == NULL && pdev->blank)
+        memset(pdev->frame, ' ', LCD_CELLS);
+    pdev->blank = false;
+    if (scr != NULL)
+    {
+        mutex_lock(&scr->lock);
+        memcpy(pdev->frame, scr->cells, LCD_CELLS);
+        if (scr->mode == LCD_MODE_TERMINAL)
+        {
+            row = scr->term.row;
+            col = scr->term.col;
+        }
+        mutex_unlock(&scr->lock);
+    }
+    // region leases go on top
+    list_for_each_entry(scr, &pdev->screens, node)
+    {
+        if (!scr->leased)
+            continue;
+        mutex_lock(&scr->lock);
+        for (i = 0; i < scr->win.height; i++)
+        {
+            cell = lcd_region_cell(&scr->win, i * scr->win.width);
+            memcpy(pdev->frame + cell, scr->cells + cell, scr->win.width);
+        }
+        mutex_unlock(&scr->lock);
+    }
+    // and the widgets, nothing else draws in their regions
+    mutex_lock(&pdev->widgets_lock);
+    list_for_each_entry(w, &pdev->widgets, node)
+    {
+        for (i = 0; i < w->win.height; i++)
+        {
+            cell = lcd_region_cell(&w->win, i * w->win.width);
+            memcpy(pdev->frame + cell, w->cells + cell, w->win.width);
+        }
+    }
+    mutex_unlock(&pdev->widgets_lock);
+    mutex_unlock(&pdev->screens_lock);
+    if (memcmp(old, pdev->frame, LCD_CELLS) != 0)
+        pdev->frame_seq++;
+
+    mutex_lock(&bus_lock);
+    // the group may have changed since the check above, lcd_set_mirror() flushes every panel again
+    if (lcd_mirror_leader(pdev) == pdev)
+    {
+        lcd_bus_select(pdev, 1);
+        lcd_mirror_prepare(pdev);
+        lcd_load_glyphs(pdev);
+        lcd_flush(pdev, 0, LCD_CELLS);
+        // parking the address counter on the terminal cursor so the blinking cursor shows it
+        if (col < NUM_CHARS_PER_LINE)
+        {
+            col += pdev->page * NUM_CHARS_PER_LINE;
+            if (pdev->ac != LCD_DDRAM_ADDR(row, col))
+            {
+                lcd_setCursor(row, col);
+                pdev->ac = LCD_DDRAM_ADDR(row, col);
+            }
+        }
+        lcd_mirror_update(pdev);
+        member_cnt = bus_group_cnt;
+        memcpy(members, bus_group, member_cnt * sizeof(members[0]));
+    }
+    mutex_unlock(&bus_lock);
+    advanced = (pdev->shown_seq != seq);
+    WRITE_ONCE(pdev->shown_seq, seq);
+    memcpy(old, pdev->frame, LCD_CELLS);
+    mutex_unlock(&pdev->frame_lock);
+
+    if (advanced)
+        lcd_frame_shown(pdev);
+    // the members are not freed meanwhile, their idle work runs on lcd_wq after this one
+    for (i = 0; i < member_cnt; i++)
+        lcd_mirror_shown(members[i], old);
+}
+
+/*
+ * description:		a mirror group member received 'frame' from its leader. Everything submitted
+ *			to the member so far is covered, its own screens are not shown while it follows.
+ */
+static void lcd_mirror_shown(struct lcd *pdev, const char *frame)
+{
+    unsigned int seq;
+    bool advanced;
+
+    mutex_lock(&pdev->frame_lock);
+    seq = atomic_read(&pdev->submit_seq);
+    if (memcmp(pdev->frame, frame, LCD_CELLS) != 0)
+    {
+        memcpy(pdev->frame, frame, LCD_CELLS);
+        pdev->frame_seq++;
+    }
+    advanced = (pdev->shown_seq != seq);
+    WRITE_ONCE(pdev->shown_seq, seq);
+    mutex_unlock(&pdev->frame_lock);
+
+    if (advanced)
+        lcd_frame_shown(pdev);
+}
+
+// a flush finished, wake poll()/fsync() and signal the registered eventfds
+static void lcd_frame_shown(struct lcd *pdev)
+{
+    struct lcd_screen *scr;
+
+    wake_up_interruptible_all(&pdev->shown_wq);
+    lcd_uring_shown(pdev);
+    mutex_lock(&pdev->screens_lock);
+    list_for_each_entry(scr, &pdev->events, event_node)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+        eventfd_signal(scr->event);
+#else
+        eventfd_signal(scr->event, 1);
+#endif
+    mutex_unlock(&pdev->screens_lock);
+}
+
+// queue the flush work, returns the sequence number the panel reaches once it ran
+static unsigned int lcd_queue_flush(struct lcd *pdev)
+{
+    unsigned int seq = atomic_inc_return(&pdev->submit_seq);
+
+    queue_work(lcd_wq, &pdev->flush_work);
+    return seq;
+}
+
+#ifdef LCD_URING
+/*
+ * description:		io_uring passthrough. The command is applied to the screen of the file right away,
+ *			like a write(), and completes once the flush covering it has reached the panel,
+ *			so an event loop learns when the text is on the glass without ever blocking on
+ *			the bus. A batch of commands is usually covered by a single flush. Waiting commands
+ *			are cancelable, a ring that exits does not wait for the panel.
+ */
+static int lcd_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags)
+{
+    struct lcd_screen *scr = (struct lcd_screen *)cmd->file->private_data;
+    struct lcd *pdev = scr->pdev;
+    struct lcd_uring_pdu *pdu = (struct lcd_uring_pdu *)cmd->pdu;
+    struct lcd_uring_op op;
+    int res;
+
+    BUILD_BUG_ON(sizeof(struct lcd_uring_pdu) > sizeof(cmd->pdu));
+    if (issue_flags & IO_URING_F_CANCEL)
+        return lcd_uring_cancel(cmd, issue_flags);
+    if (list_empty(&scr->node))
+        return -EBADF; // files opened read only have no screen on the panel
+    // the sqe is shared with userspace, it is read once
+    memcpy(&op, io_uring_sqe_cmd(cmd->sqe), sizeof(op));
+
+    // a glyph belongs to the panel, not to the screen of the file
+    if (cmd->cmd_op == LCD_URING_GLYPH)
+        res = lcd_uring_glyph(pdev, &op, issue_flags);
+    else
+        res = lcd_uring_screen(scr, cmd->cmd_op, &op, issue_flags);
+    if (res < 0)
+        return res;
+    if (cmd->cmd_op != LCD_URING_SYNC && cmd->cmd_op != LCD_URING_GLYPH)
+        lcd_screen_submit(scr);
+
+    // queued under uring_lock, so the flush that covers seq finds the command in the list
+    pdu->cmd = cmd;
+    pdu->res = res;
+    // before it is on the list, a flush may complete it right after
+    io_uring_cmd_mark_cancelable(cmd, issue_flags);
+    spin_lock(&pdev->uring_lock);
+    pdu->seq = lcd_queue_flush(pdev);
+    list_add_tail(&pdu->node, &pdev->uring_cmds);
+    spin_unlock(&pdev->uring_lock);
+    return -EIOCBQUEUED;
+}
+
+// LCD_URING_WRITE, LCD_URING_CLEAR and LCD_URING_SYNC on the screen of the file
+static int lcd_uring_screen(struct lcd_screen *scr, unsigned int cmd_op, const struct lcd_uring_op *op,
+                            unsigned int issue_flags)
+{
+    size_t done, seg;
+    int res = 0;
+
+    // the screen lock may be held across a whole write, let io_uring retry from a worker
+    if (issue_flags & IO_URING_F_NONBLOCK)
+    {
+        if (!mutex_trylock(&scr->lock))
+            return -EAGAIN;
+    }
+    else
+    {
+        mutex_lock(&scr->lock);
+    }
+
+    switch (cmd_op)
+    {
+    case LCD_URING_WRITE:
+        if (op->offset > lcd_region_size(&scr->win) || op->len > lcd_region_size(&scr->win) - op->offset)
+        {
+            res = -EINVAL;
+            break;
+        }
+        for (done = 0; done < op->len; done += seg)
+        {
+            seg = min_t(size_t, op->len - done, scr->win.width - (op->offset + done) % scr->win.width);
+            if (copy_from_user(scr->cells + lcd_region_cell(&scr->win, op->offset + done),
+                               u64_to_user_ptr(op->addr) + done, seg) != 0)
+                break;
+        }
+        res = done ? done : (op->len ? -EFAULT : 0);
+        break;
+    case LCD_URING_CLEAR:
+        lcd_screen_clear(scr);
+        break;
+    case LCD_URING_SYNC:
+        break;
+    default:
+        res = -EINVAL;
+        break;
+    }
+    mutex_unlock(&scr->lock);
+    return res;
+}
+
+/*
+ * description:		LCD_URING_GLYPH, keep the rows of user character op->offset for the next flush,
+ *			which writes it into CGRAM. Returns the number of rows.
+ */
+static int lcd_uring_glyph(struct lcd *pdev, const struct lcd_uring_op *op, unsigned int issue_flags)
+{
+    unsigned char rows[LCD_GLYPH_ROWS];
+
+    if (op->offset >= LCD_GLYPHS || op->len != LCD_GLYPH_ROWS)
+        return -EINVAL;
+    if (copy_from_user(rows, u64_to_user_ptr(op->addr), LCD_GLYPH_ROWS) != 0)
+        return -EFAULT;
+
+    // frame_lock is held across flushes, let io_uring retry from a worker
+    if (issue_flags & IO_URING_F_NONBLOCK)
+    {
+        if (!mutex_trylock(&pdev->frame_lock))
+            return -EAGAIN;
+    }
+    else
+    {
+        mutex_lock(&pdev->frame_lock);
+    }
+    memcpy(pdev->glyphs[op->offset], rows, LCD_GLYPH_ROWS);
+    pdev->glyph_dirty |= BV(op->offset);
+    mutex_unlock(&pdev->frame_lock);
+    return LCD_GLYPH_ROWS;
+}
+
+/*
+ * description:		IO_URING_F_CANCEL, the ring of a waiting command exits. The command is completed
+ *			with -ECANCELED unless lcd_uring_shown() already took it off the list.
+ */
+static int lcd_uring_cancel(struct io_uring_cmd *cmd, unsigned int issue_flags)
+{
+    struct lcd_screen *scr = (struct lcd_screen *)cmd->file->private_data;
+    struct lcd *pdev = scr->pdev;
+    struct lcd_uring_pdu *pdu;
+    bool found = false;
+
+    spin_lock(&pdev->uring_lock);
+    list_for_each_entry(pdu, &pdev->uring_cmds, node)
+    {
+        if (pdu->cmd == cmd)
+        {
+            list_del(&pdu->node);
+            found = true;
+            break;
+        }
+    }
+    spin_unlock(&pdev->uring_lock);
+
+    if (found)
+        io_uring_cmd_done(cmd, -ECANCELED, 0, issue_flags);
+    return 0;
+}
+
+static void lcd_uring_done(struct io_uring_cmd *cmd, unsigned int issue_flags)
+{
+    struct lcd_uring_pdu *pdu = (struct lcd_uring_pdu *)cmd->pdu;
+
+    io_uring_cmd_done(cmd, pdu->res, 0, issue_flags);
+}
+#endif
+
+// post the cqes of the commands whose frame is on the panel now
+static void lcd_uring_shown(struct lcd *pdev)
+{
+#ifdef LCD_URING
+    struct lcd_uring_pdu *pdu, *tmp;
+    LIST_HEAD(done);
+
+    spin_lock(&pdev->uring_lock);
+    list_for_each_entry_safe(pdu, tmp, &pdev->uring_cmds, node)
+    {
+        if (lcd_seq_shown(pdev, pdu->seq))
+            list_move_tail(&pdu->node, &done);
+    }
+    spin_unlock(&pdev->uring_lock);
+
+    list_for_each_entry_safe(pdu, tmp, &done, node)
+    {
+        list_del(&pdu->node);
+        io_uring_cmd_complete_in_task(pdu->cmd, lcd_uring_done);
+    }
+#endif
+}
+
+// sequence numbers wrap, 'seq' is shown once shown_seq is at or past it
+static int lcd_seq_shown(struct lcd *pdev, unsigned int seq)
+{
+    return (int)(READ_ONCE(pdev->shown_seq) - seq) >= 0;
+}
+
+// LCD_SET_EVENTFD, fd < 0 drops the registration
+static int lcd_set_eventfd(struct lcd_screen *scr, int fd)
+{
+    struct lcd *pdev = scr->pdev;
+    struct eventfd_ctx *ctx = NULL, *old;
+
+    if (fd >= 0)
+    {
+        ctx = eventfd_ctx_fdget(fd);
+        if (IS_ERR(ctx))
+            return PTR_ERR(ctx);
+    }
+
+    mutex_lock(&pdev->screens_lock);
+    old = scr->event;
+    if (old != NULL)
+        list_del_init(&scr->event_node);
+    scr->event = ctx;
+    if (ctx != NULL)
+        list_add_tail(&scr->event_node, &pdev->events);
+    mutex_unlock(&pdev->screens_lock);
+
+    if (old != NULL)
+        eventfd_ctx_put(old);
+    return 0;
+}
+
+/*
+ * description:		set up /dev/bbb_lcd_wall0 over the first wall_cols * wall_rows panels.
+ *			The wall owns one screen on every tile panel. Those screens are ordinary screens of
+ *			their panels, so the selection policy, the leases and widgets on top and the diff
+ *			flush of every panel apply to the wall as well.
+ */
+static int lcd_wall_init(dev_t devno)
+{
+    struct lcd *pdev;
+    struct device *pdevice;
+    unsigned int i, tiles = wall_cols * wall_rows;
+    int ret;
+
+    wall.devno = devno;
+    wall.width = wall_cols * NUM_CHARS_PER_LINE;
+    wall.height = wall_rows * NUM_LINES;
+    mutex_init(&wall.lock);
+
+    wall.cells = kmalloc(wall.width * wall.height, GFP_KERNEL);
+    wall.tile = kcalloc(tiles, sizeof(*wall.tile), GFP_KERNEL);
+    if (wall.cells == NULL || wall.tile == NULL)
+    {
+        ret = -ENOMEM;
+        goto wall_alloc_failed;
+    }
+    memset(wall.cells, ' ', wall.width * wall.height);
+    for (i = 0; i < tiles; i++)
+    {
+        // the wall keeps its panels for good, lcd_devs_free() releases them
+        pdev = lcd_get(i);
+        if (pdev == NULL)
+        {
+            ret = -ENOMEM;
+            goto wall_alloc_failed;
+        }
+        wall.tile[i] = lcd_screen_new(pdev);
+        if (wall.tile[i] == NULL)
+        {
+            ret = -ENOMEM;
+            goto wall_alloc_failed;
+        }
+        lcd_screen_clear(wall.tile[i]);
+    }
+
+    pdevice = device_create(pclass, NULL, devno, NULL, "bbb_lcd_wall0");
+    if (IS_ERR(pdevice))
+    {
+        ret = PTR_ERR(pdevice);
+        goto wall_alloc_failed;
+    }
+    cdev_init(&wall.cdev, &wall_f_ops);
+    ret = cdev_add(&wall.cdev, devno, 1);
+    if (ret != 0)
+        goto wall_cdev_add_failed;
+    printk(KERN_INFO "%s : %ux%u wall of %u panels is ready\n", THIS_MODULE->name, wall.width, wall.height, tiles);
+
+    return 0;
+
+wall_cdev_add_failed:
+    device_destroy(pclass, devno);
+wall_alloc_failed:
+    for (i = 0; wall.tile != NULL && i < tiles; i++)
+        kfree(wall.tile[i]);
+    kfree(wall.tile);
+    kfree(wall.cells);
+    mutex_destroy(&wall.lock);
+    return ret;
+}
+
+// the flush work is gone already, the tile screens are only reachable through the lists of the panels
+static void lcd_wall_free(void)
+{
+    unsigned int i;
+
+    cdev_del(&wall.cdev);
+    device_destroy(pclass, wall.devno);
+    for (i = 0; i < wall_cols * wall_rows; i++)
+    {
+        if (!list_empty(&wall.tile[i]->node))
+            list_del(&wall.tile[i]->node);
+        mutex_destroy(&wall.tile[i]->lock);
+        kfree(wall.tile[i]);
+    }
+    kfree(wall.tile);
+    kfree(wall.cells);
+    mutex_destroy(&wall.lock);
+}
+
+/*
+ * description:		copy the wall into the tile screens and let the panels whose part changed flush.
+ *			Every panel only sends the cells of its own tile that differ from what it shows.
+ *			Caller holds wall.lock.
+ */
+static void lcd_wall_update(void)
+{
+    struct lcd_screen *scr;
+    unsigned int i, r;
+    const char *src;
+    bool changed;
+
+    for (i = 0; i < wall_cols * wall_rows; i++)
+    {
+        scr = wall.tile[i];
+        changed = false;
+        mutex_lock(&scr->lock);
+        for (r = 0; r < NUM_LINES; r++)
+        {
+            src = wall.cells + ((i / wall_cols) * NUM_LINES + r) * wall.width + (i % wall_cols) * NUM_CHARS_PER_LINE;
+            if (memcmp(scr->cells + r * NUM_CHARS_PER_LINE, src, NUM_CHARS_PER_LINE) != 0)
+            {
+                memcpy(scr->cells + r * NUM_CHARS_PER_LINE, src, NUM_CHARS_PER_LINE);
+                changed = true;
+            }
+        }
+        mutex_unlock(&scr->lock);
+
+        // from the first write on the tile screens compete for their panels like any open file
+        if (!wall.live)
+        {
+            mutex_lock(&scr->pdev->screens_lock);
+            scr->id = ++scr->pdev->next_id;
+            list_add_tail(&scr->node, &scr->pdev->screens);
+            mutex_unlock(&scr->pdev->screens_lock);
+        }
+        if (changed)
+            lcd_screen_changed(scr);
+    }
+    wall.live = true;
+}
+
+static int lcd_wall_open(struct inode *pinode, struct file *pfile)
+{
+    printk(KERN_INFO "%s : lcd_wall_open is called\n", THIS_MODULE->name);
+
+    if ((pfile->f_mode & FMODE_WRITE) && (pfile->f_flags & O_TRUNC))
+    {
+        mutex_lock(&wall.lock);
+        memset(wall.cells, ' ', wall.width * wall.height);
+        lcd_wall_update();
+        mutex_unlock(&wall.lock);
+    }
+    return 0;
+}
+
+// the cells the tile panels show, put together into one wall
+static ssize_t lcd_wall_read(struct file *pfile, char __user *ubuf, size_t size, loff_t *poffset)
+{
+    unsigned int i, r, total = wall.width * wall.height;
+    loff_t pos = *poffset;
+    struct lcd *pdev;
+    size_t len;
+    char *img;
+
+    if (pos < 0)
+        return -EINVAL;
+    if (pos >= total)
+        return 0;
+    len = min_t(size_t, size, total - pos);
+
+    img = kmalloc(total, GFP_KERNEL);
+    if (img == NULL)
+        return -ENOMEM;
+    for (i = 0; i < wall_cols * wall_rows; i++)
+    {
+        pdev = wall.tile[i]->pdev;
+        mutex_lock(&pdev->frame_lock);
+        for (r = 0; r < NUM_LINES; r++)
+            memcpy(img + ((i / wall_cols) * NUM_LINES + r) * wall.width + (i % wall_cols) * NUM_CHARS_PER_LINE,
+                   pdev->frame + r * NUM_CHARS_PER_LINE, NUM_CHARS_PER_LINE);
+        mutex_unlock(&pdev->frame_lock);
+    }
+    if (copy_to_user(ubuf, img + pos, len) != 0)
+    {
+        kfree(img);
+        return -EFAULT;
+    }
+    kfree(img);
+
+    *poffset = pos + len;
+    return len;
+}
+
+/*
+ * description:		write into the wall starting at the file offset, row * width + col of the whole wall.
+ *			The text is split per tile here, userspace writes the wall as one display.
+ */
+static ssize_t lcd_wall_write(struct file *pfile, const char __user *ubuf, size_t size, loff_t *poffset)
+{
+    unsigned int total = wall.width * wall.height;
+    loff_t pos = *poffset;
+    size_t len;
+
+    if (pos < 0)
+        return -EINVAL;
+    if (size == 0)
+        return 0;
+    if (pos >= total)
+        return -ENOSPC;
+    len = min_t(size_t, size, total - pos);
+
+    mutex_lock(&wall.lock);
+    if (copy_from_user(wall.cells + pos, ubuf, len) != 0)
+    {
+        mutex_unlock(&wall.lock);
+        return -EFAULT;
+    }
+    lcd_wall_update();
+    mutex_unlock(&wall.lock);
+
+    *poffset = pos + len;
+    return len;
+}
+
+static loff_t lcd_wall_llseek(struct file *pfile, loff_t offset, int whence)
+{
+    return fixed_size_llseek(pfile, offset, whence, wall.width * wall.height);
+}
+
+// lowest panel of the mirror group of pdev, it composites the frame the group shows. Caller holds bus_lock.
+static struct lcd *lcd_mirror_leader(struct lcd *pdev)
+{
+    int i;
+
+    if (pdev->mirror == 0)
+        return pdev;
+    for (i = 0; i < pdev->minor; i++)
+    {
+        if (dev[i] != NULL && dev[i]->mirror == pdev->mirror)
+            return dev[i];
+    }
+    return pdev;
+}
+
+/*
+ * description:		LCD_SET_MIRROR, put the panel into mirror group 'group', 0 takes it out again.
+ *			The panels of a group show the frame of the lowest panel in it. The frame is sent
+ *			once with the EN lines of all of them strobed together, so the group costs the bus
+ *			time of one panel. Only panels with an EN line of their own can join, and page flip
+ *			has to be off.
+ */
+static int lcd_set_mirror(struct lcd *pdev, unsigned int group)
+{
+    unsigned int old;
+    int i;
+
+    if (group != 0 && pdev->minor >= lcd_en_cnt)
+        return -EINVAL;
+
+    mutex_lock(&pdev->frame_lock);
+    mutex_lock(&bus_lock);
+    if (group != 0 && pdev->page_flip)
+    {
+        mutex_unlock(&bus_lock);
+        mutex_unlock(&pdev->frame_lock);
+        return -EBUSY;
+    }
+    old = pdev->mirror;
+    pdev->mirror = group;
+    mutex_unlock(&bus_lock);
+    mutex_unlock(&pdev->frame_lock);
+    printk(KERN_INFO "%s : panel %d mirror group %u\n", THIS_MODULE->name, pdev->minor, group);
+
+    // the leaders of both groups may have changed, every panel involved composites again
+    mutex_lock(&dev_lock);
+    for (i = 0; i < dev_cnt; i++)
+    {
+        if (dev[i] == pdev || (dev[i] != NULL && READ_ONCE(dev[i]->mirror) != 0 &&
+                               (READ_ONCE(dev[i]->mirror) == old || READ_ONCE(dev[i]->mirror) == group)))
+            lcd_queue_flush(dev[i]);
+    }
+    mutex_unlock(&dev_lock);
+    return 0;
+}
+
+/*
+ * description:		choose the panels the following bus transfers go to. Caller holds bus_lock.
+ * @param pdev		panel to talk to, NULL for all of them
+ * @param group		also strobe the other members of the mirror group of pdev. Their mirrors are
+ *			then kept in step with the one of pdev through bus_group.
+ */
+static void lcd_bus_select(struct lcd *pdev, int group)
+{
+    unsigned int j;
+    int i, en;
+
+    bus_en_cnt = 0;
+    bus_group_cnt = 0;
+    memset(bus_en_mask, 0, sizeof(bus_en_mask));
+    for (i = 0; i < dev_cnt; i++)
+    {
+        if (pdev != NULL && i != pdev->minor)
+        {
+            if (!group || pdev->mirror == 0 || dev[i] == NULL || dev[i]->mirror != pdev->mirror)
+                continue;
+            bus_group[bus_group_cnt++] = dev[i];
+        }
+
+        // panels without an EN line of their own all share LCD_EN
+        en = lcd_en_of(i);
+        for (j = 0; j < bus_en_cnt && bus_en[j] != en; j++)
+            ;
+        if (j < bus_en_cnt)
+            continue;
+        bus_en[bus_en_cnt++] = en;
+        if (LCD_GPIO_BANK(en) < LCD_GPIO_BANKS)
+            bus_en_mask[LCD_GPIO_BANK(en)] |= LCD_GPIO_BIT(en);
+    }
+    lcd_bus_timing();
+}
+
+// only panel 'minor', whether it is in use or not. Caller holds bus_lock.
+static void lcd_bus_select_one(unsigned int minor)
+{
+    int en = lcd_en_of(minor);
+
+    bus_en[0] = en;
+    bus_en_cnt = 1;
+    bus_group_cnt = 0;
+    memset(bus_en_mask, 0, sizeof(bus_en_mask));
+    if (LCD_GPIO_BANK(en) < LCD_GPIO_BANKS)
+        bus_en_mask[LCD_GPIO_BANK(en)] |= LCD_GPIO_BIT(en);
+    lcd_bus_timing();
+}
+
+// wait of a measured busy time, the default for a panel that was not calibrated
+static unsigned int lcd_timing_us(unsigned int measured)
+{
+    if (measured == 0)
+        return LCD_BUSY_DEFAULT_US;
+    return measured + measured * READ_ONCE(timing_margin) / 100;
+}
+
+/*
+ * description:		waits for the selected panels. Every panel on a selected EN line takes the transfer,
+ *			so the slowest of them sets the pace, panels that were not calibrated keep 2 ms.
+ *			The same panels go into bus_panels for the capture. Caller holds bus_lock.
+ */
+static void lcd_bus_timing(void)
+{
+    unsigned int j;
+    int i;
+
+    memset(&bus_timing, 0, sizeof(bus_timing));
+    bus_fast_us = 0;
+    bus_panels = 0;
+    for (i = 0; i < dev_cnt; i++)
+    {
+        for (j = 0; j < bus_en_cnt && bus_en[j] != lcd_en_of(i); j++)
+            ;
+        if (j == bus_en_cnt)
+            continue;
+        if (i < 32)
+            bus_panels |= 1u << i;
+        bus_timing.cmd_us = max(bus_timing.cmd_us, lcd_timing_us(READ_ONCE(timing[i].cmd_us)));
+        bus_timing.data_us = max(bus_timing.data_us, lcd_timing_us(READ_ONCE(timing[i].data_us)));
+        bus_timing.home_us = max(bus_timing.home_us, lcd_timing_us(READ_ONCE(timing[i].home_us)));
+        // the 2 ms default covers return home, a 37 us shift must not pay it
+        if (READ_ONCE(timing[i].cmd_us) == 0)
+            bus_fast_us = max(bus_fast_us, (unsigned int)LCD_FAST_CMD_US);
+        else
+            bus_fast_us = max(bus_fast_us, lcd_timing_us(READ_ONCE(timing[i].cmd_us)));
+    }
+}
+
+// whether another panel shares the EN line of 'minor', it would answer a read as well
+static int lcd_en_shared(unsigned int minor)
+{
+    int i, n = 0;
+
+    for (i = 0; i < dev_cnt; i++)
+        n += (lcd_en_of(i) == lcd_en_of(minor));
+    return n > 1;
+}
+
+/*
+ * description:		line up the mirrors of the group with the one of pdev before a broadcast.
+ *			A display shift that differs is undone on all panels with one return home and an
+ *			address counter that differs is forgotten. DDRAM cells that differ are sent by
+ *			lcd_flush_page(). Caller holds frame_lock of pdev and bus_lock, after lcd_bus_select().
+ */
+static void lcd_mirror_prepare(struct lcd *pdev)
+{
+    unsigned int i;
+    bool home = false, ac = false;
+
+    for (i = 0; i < bus_group_cnt; i++)
+    {
+        home |= (bus_group[i]->shift != pdev->shift);
+        ac |= (bus_group[i]->ac != pdev->ac);
+    }
+    if (home)
+    {
+        lcd_returnHome();
+        pdev->shift = 0;
+        pdev->page = 0;
+        pdev->ac = 0; // return home also sets the address counter to 0
+    }
+    else if (ac)
+    {
+        pdev->ac = -1;
+    }
+    lcd_mirror_update(pdev);
+}
+
+// after a broadcast the other panels of the group are where pdev is. Caller holds bus_lock.
+static void lcd_mirror_update(struct lcd *pdev)
+{
+    unsigned int i;
+
+    for (i = 0; i < bus_group_cnt; i++)
+    {
+        bus_group[i]->ac = pdev->ac;
+        bus_group[i]->page = pdev->page;
+        bus_group[i]->shift = pdev->shift;
+    }
+}
+
+// whether every other panel of the broadcast already holds 'c' in DDRAM at row/col
+static int lcd_mirror_holds(unsigned int row, unsigned int col, char c)
+{
+    unsigned int i;
+
+    for (i = 0; i < bus_group_cnt; i++)
+    {
+        if (bus_group[i]->ddram[row][col] != c)
+            return 0;
+    }
+    return 1;
+}
+
+static int lcd_all_pin_init(void)
+{
+    int i, ret;
+    int size = ARRAY_SIZE(lcd_pin); // ARRAY_SIZE() is macro define the kernel and it returns the number of elements inside the array
+    bool valid;
+    char *lcd_pin_name[] = {"LCD_RS", "LCD_EN", "LCD_D4", "LCD_D5", "LCD_D6", "LCD_D7"};
+
+    for (i = 0; i < size; i++)
+    {
+        valid = gpio_is_valid(lcd_pin[i]);
+        if (!valid)
+        {
+            printk(KERN_INFO "%s: GPIO pin %d is invalid\n", THIS_MODULE->name, lcd_pin[i]);
+            ret = -EINVAL;
+            goto gpio_invalid;
+        }
+        printk(KERN_INFO "%s : GPIO pin %d is valid\n", THIS_MODULE->name, lcd_pin[i]);
+
+        ret = gpio_request(lcd_pin[i], lcd_pin_name[i]);
+        if (ret != 0)
+        {
+            printk(KERN_INFO "%s : GPIO pid %d is busy\n", THIS_MODULE->name, lcd_pin[i]);
+            ret = -EBUSY;
+            goto gpio_invalid;
+        }
+
+        ret = gpio_direction_output(lcd_pin[i], 0);
+        if (ret != 0)
+        {
+            printk(KERN_INFO "%s : GPIO pin %d direction is not set\n", THIS_MODULE->name, lcd_pin[i]);
+            ret = -EIO;
+            goto gpio_dirction_failed;
+        }
+        printk(KERN_INFO "%s : GPIO pin %d direction set as output\n", THIS_MODULE->name, lcd_pin[i]);
+    }
+
+    printk(KERN_INFO "%s : Lcd_all_pin_init is successful\n", THIS_MODULE->name);
+
+    return 0;
+
+gpio_dirction_failed:
+    gpio_free(lcd_pin[i]);
+gpio_invalid:
+    for (i = i - 1; i > 0; i--)
+        gpio_free(lcd_pin[i]);
+
+    return ret;
+}
+
+static void lcd_all_pin_free(void)
+{
+    int i, size;
+    size = ARRAY_SIZE(lcd_pin);
+
+    for (i = 0; i < size; i++)
+    {
+        gpio_free(lcd_pin[i]);// releasing the all the gpio pin of BBB
+    }
+}
+
+// whether lcd_en[i] has to be requested, LCD_EN is requested by lcd_all_pin_init() and repeats only once
+static int lcd_en_own(int i)
+{
+    int j;
+
+    if (lcd_en[i] == LCD_EN)
+        return 0;
+    for (j = 0; j < i; j++)
+    {
+        if (lcd_en[j] == lcd_en[i])
+            return 0;
+    }
+    return 1;
+}
+
+static int lcd_en_pin_init(void)
+{
+    int i, ret;
+
+    for (i = 0; i < lcd_en_cnt; i++)
+    {
+        // the register backend only maps the banks of the lcd pins
+        if (!gpio_is_valid(lcd_en[i]) || (use_mmio && LCD_GPIO_BANK(lcd_en[i]) >= LCD_GPIO_BANKS))
+        {
+            printk(KERN_INFO "%s: EN pin %d of panel %d is invalid\n", THIS_MODULE->name, lcd_en[i], i);
+            ret = -EINVAL;
+            goto en_pin_failed;
+        }
+        if (!lcd_en_own(i))
+            continue;
+
+        ret = gpio_request(lcd_en[i], "LCD_EN");
+        if (ret != 0)
+        {
+            printk(KERN_INFO "%s : GPIO pin %d is busy\n", THIS_MODULE->name, lcd_en[i]);
+            ret = -EBUSY;
+            goto en_pin_failed;
+        }
+        ret = gpio_direction_output(lcd_en[i], 0);
+        if (ret != 0)
+        {
+            printk(KERN_INFO "%s : GPIO pin %d direction is not set\n", THIS_MODULE->name, lcd_en[i]);
+            gpio_free(lcd_en[i]);
+            ret = -EIO;
+            goto en_pin_failed;
+        }
+    }
+
+    return 0;
+
+en_pin_failed:
+    for (i = i - 1; i >= 0; i--)
+    {
+        if (lcd_en_own(i))
+            gpio_free(lcd_en[i]);
+    }
+
+    return ret;
+}
+
+static void lcd_en_pin_free(void)
+{
+    int i;
+
+    for (i = 0; i < lcd_en_cnt; i++)
+    {
+        if (lcd_en_own(i))
+            gpio_free(lcd_en[i]);
+    }
+}
+
+static int lcd_rw_pin_init(void)
+{
+    int ret;
+
+    if (!gpio_is_valid(LCD_RW))
+        return -EINVAL;
+    ret = gpio_request(LCD_RW, "LCD_RW");
+    if (ret != 0)
+    {
+        printk(KERN_INFO "%s : GPIO pin %d is busy\n", THIS_MODULE->name, LCD_RW);
+        return -EBUSY;
+    }
+    ret = gpio_direction_output(LCD_RW, 0);
+    if (ret != 0)
+    {
+        gpio_free(LCD_RW);
+        return -EIO;
+    }
+    return 0;
+}
+
+static int lcd_mmio_init(void)
+{
+    int i;
+
+    for (i = 0; i < LCD_GPIO_BANKS; i++)
+    {
+        gpio_bank[i] = ioremap(gpio_bank_base[i], GPIO_BANK_SIZE);
+        if (gpio_bank[i] == NULL)
+        {
+            printk(KERN_INFO "%s : ioremap() of gpio bank %d failed\n", THIS_MODULE->name, i);
+            goto ioremap_failed;
+        }
+    }
+    printk(KERN_INFO "%s : gpio banks are mapped, using register backend\n", THIS_MODULE->name);
+
+    return 0;
+
+ioremap_failed:
+    for (i = i - 1; i >= 0; i--)
+        iounmap(gpio_bank[i]);
+
+    return -ENOMEM;
+}
+
+static void lcd_mmio_free(void)
+{
+    int i;
+
+    for (i = 0; i < LCD_GPIO_BANKS; i++)
+        iounmap(gpio_bank[i]);
+}
+
+/*
+ * description:		put one nibble of 'byte' on D7..D4 and 'rs' on RS with direct register stores.
+ * @param bank		mapped GPIO0..GPIO2 banks. Any zeroed memory block of GPIO_BANK_SIZE bytes per bank can be
+ *			passed instead, the SETDATAOUT/CLEARDATAOUT words then hold the masks that would have been stored.
+ * @param half		0 for the upper nibble, 1 for the lower nibble
+ */
+static void lcd_mmio_nibble(void __iomem *const *bank, unsigned char byte, int half, int rs)
+{
+    const struct lcd_bank_mask *mask = lcd_byte_mask[byte].nib[half];
+    unsigned int set, clr;
+    int i;
+
+    for (i = 0; i < LCD_GPIO_BANKS; i++)
+    {
+        set = mask[i].set;
+        clr = mask[i].clr;
+        if (rs)
+            set |= LCD_PIN_MASK(LCD_RS, i);
+        else
+            clr |= LCD_PIN_MASK(LCD_RS, i);
+
+        // banks without a pin to change are skipped
+        if (clr)
+            writel(clr, bank[i] + GPIO_CLEARDATAOUT);
+        if (set)
+            writel(set, bank[i] + GPIO_SETDATAOUT);
+    }
+}
+
+// EN lines of all selected panels go up and down together
+static void lcd_mmio_strobe(void __iomem *const *bank)
+{
+    int i;
+
+    for (i = 0; i < LCD_GPIO_BANKS; i++)
+    {
+        if (bus_en_mask[i])
+            writel(bus_en_mask[i], bank[i] + GPIO_SETDATAOUT);
+    }
+    lcd_bus_sleep(5, 10);
+    for (i = 0; i < LCD_GPIO_BANKS; i++)
+    {
+        if (bus_en_mask[i])
+            writel(bus_en_mask[i], bank[i] + GPIO_CLEARDATAOUT);
+    }
+}
+
+// every delay the bus protocol needs goes through here, so bus_stats models the time of an operation
+static void lcd_bus_sleep(unsigned int min_us, unsigned int max_us)
+{
+    bus_stats.bus_us += min_us;
+    if (!dry_run)
+        usleep_range(min_us, max_us);
+}
+
+/*
+ * description:		ring for capture_kb of nibble records and its debugfs file. A debugfs that is not
+ *			there only loses the file, the driver runs the same.
+ */
+static int lcd_capture_init(void)
+{
+    capture_len = capture_kb * 1024 / sizeof(*capture);
+    if (capture_len == 0)
+        return -EINVAL;
+    capture = vzalloc(capture_len * sizeof(*capture));
+    if (capture == NULL)
+        return -ENOMEM;
+
+    lcd_debugfs = debugfs_create_dir("bbb_lcd", NULL);
+    debugfs_create_file("capture", 0400, lcd_debugfs, NULL, &capture_f_ops);
+    printk(KERN_INFO "%s : capturing the last %u nibbles of the bus\n", THIS_MODULE->name, capture_len);
+    return 0;
+}
+
+static void lcd_capture_free(void)
+{
+    debugfs_remove_recursive(lcd_debugfs);
+    vfree(capture);
+    capture = NULL;
+}
+
+// one nibble into the capture ring, the oldest record gives way. Caller holds bus_lock.
+static void lcd_capture(unsigned char nibble, int flags)
+{
+    struct lcd_capture_rec *rec = &capture[capture_head % capture_len];
+
+    rec->ns = ktime_get_ns();
+    rec->panels = bus_panels;
+    rec->seq = (unsigned short)capture_head;
+    rec->flags = flags;
+    rec->nibble = nibble & 0x0F;
+    capture_head++;
+}
+
+/*
+ * description:		the capture as an array of struct lcd_capture_rec, the file offset counts from the
+ *			first record since the module was loaded. Records the ring has overwritten are
+ *			skipped, the seq of the next record shows how many. Nothing is consumed, so
+ *			cat of the file gives what the ring holds and a reader that keeps the file open
+ *			picks up where it stopped.
+ */
+static ssize_t lcd_capture_read(struct file *pfile, char __user *ubuf, size_t size, loff_t *poffset)
+{
+    struct lcd_capture_rec *buf;
+    unsigned long long pos = *poffset / sizeof(*buf), first;
+    size_t i, n = min_t(size_t, size / sizeof(*buf), LCD_CAPTURE_CHUNK);
+    ssize_t ret;
+
+    if (n == 0)
+        return -EINVAL;
+    buf = kmalloc_array(n, sizeof(*buf), GFP_KERNEL);
+    if (buf == NULL)
+        return -ENOMEM;
+
+    // copied out under bus_lock, the bus only waits for LCD_CAPTURE_CHUNK records
+    mutex_lock(&bus_lock);
+    first = (capture_head > capture_len) ? capture_head - capture_len : 0;
+    if (pos < first)
+        pos = first;
+    n = min_t(unsigned long long, n, capture_head - pos);
+    for (i = 0; i < n; i++)
+        buf[i] = capture[(pos + i) % capture_len];
+    mutex_unlock(&bus_lock);
+
+    ret = n * sizeof(*buf);
+    if (copy_to_user(ubuf, buf, ret) != 0)
+        ret = -EFAULT;
+    else
+        *poffset = (pos + n) * sizeof(*buf);
+    kfree(buf);
+    return ret;
+}
+
+static void lcd_bus_udelay(unsigned int us)
+{
+    bus_stats.bus_us += us;
+    if (!dry_run)
+        udelay(us);
+}
+
+// wait out the busy time of the last transfer, a sleep shorter than its own overshoot is spun instead
+static void lcd_bus_wait(unsigned int us)
+{
+    unsigned int late = READ_ONCE(sleep_overshoot_us);
+
+    if (us == 0)
+        return;
+    if (us < late)
+        lcd_bus_udelay(us);
+    else
+        lcd_bus_sleep(us, us + max(late, us / 2));
+}
+
+/*
+ * description:		latch one nibble into the HD44780 (falling edge of EN).
+ * @param byte		byte holding the nibble
+ * @param half		0 sends bit 7 to bit 4, 1 sends bit 3 to bit 0
+ * @param rs		LCD_CMD or LCD_DATA
+ */
+static void lcd_write_nibble(char byte, int half, int rs)
+{
+    unsigned char nib = half ? (byte & 0x0F) : ((byte >> 4) & 0x0F);
+    unsigned int i;
+
+    if (rs == LCD_DATA)
+        bus_stats.data_nibbles++;
+    else
+        bus_stats.cmd_nibbles++;
+    // at the start of the strobe, close enough to the falling edge for the replay
+    if (capture != NULL)
+        lcd_capture(nib, rs == LCD_DATA ? LCD_CAP_RS : 0);
+
+    if (dry_run)
+    {
+        // the bus time of a real strobe, without touching the pins
+        lcd_bus_sleep(5, 10);
+        lcd_bus_sleep(5, 10);
+        return;
+    }
+
+    if (use_mmio)
+    {
+        lcd_mmio_nibble(gpio_bank, (unsigned char)byte, half, rs);
+        lcd_bus_sleep(5, 10);
+        lcd_mmio_strobe(gpio_bank);
+        return;
+    }
+
+    gpio_set_value(LCD_D7, (nib >> 3) & 0x1);
+    gpio_set_value(LCD_D6, (nib >> 2) & 0x1);
+    gpio_set_value(LCD_D5, (nib >> 1) & 0x1);
+    gpio_set_value(LCD_D4, nib & 0x1);
+
+    gpio_set_value(LCD_RS, rs);
+    lcd_bus_sleep(5, 10);
+
+    // Simulating falling edge triggered clock, on every selected panel at once
+    for (i = 0; i < bus_en_cnt; i++)
+        gpio_set_value(bus_en[i], 1);
+    lcd_bus_sleep(5, 10);
+    for (i = 0; i < bus_en_cnt; i++)
+        gpio_set_value(bus_en[i], 0);
+}
+
+/*
+ * description:		read one byte from the selected panel, two nibbles with RW high.
+ *			D4-D7 are inputs for the time of the read and outputs again afterwards.
+ *			Only one panel may be selected, the others would drive D4-D7 as well.
+ * @param rs		LCD_CMD reads busy flag and address counter, LCD_DATA the DDRAM cell at the address counter
+ */
+static unsigned char lcd_read_byte(int rs)
+{
+    static const int data_pin[] = {LCD_D4, LCD_D5, LCD_D6, LCD_D7};
+    unsigned char byte = 0;
+    int half, i;
+
+    for (i = 0; i < ARRAY_SIZE(data_pin); i++)
+        gpio_direction_input(data_pin[i]);
+    gpio_set_value(LCD_RS, rs);
+    gpio_set_value(LCD_RW, 1);
+    lcd_bus_sleep(5, 10);
+
+    for (half = 0; half < 2; half++)
+    {
+        if (rs == LCD_DATA)
+            bus_stats.data_nibbles++;
+        else
+            bus_stats.cmd_nibbles++;
+
+        // the data is valid while EN is high
+        gpio_set_value(bus_en[0], 1);
+        lcd_bus_sleep(5, 10);
+        byte <<= 4;
+        for (i = 0; i < ARRAY_SIZE(data_pin); i++)
+            byte |= (gpio_get_value(data_pin[i]) ? 1 : 0) << i;
+        gpio_set_value(bus_en[0], 0);
+        if (capture != NULL)
+            lcd_capture(byte & 0x0F, LCD_CAP_READ | (rs == LCD_DATA ? LCD_CAP_RS : 0));
+        lcd_bus_sleep(5, 10);
+    }
+
+    gpio_set_value(LCD_RW, 0);
+    for (i = 0; i < ARRAY_SIZE(data_pin); i++)
+        gpio_direction_output(data_pin[i], 0);
+    return byte;
+}
+
+/*
+ * description:		bring a panel that lost the nibble phase back into 4 bit mode.
+ *			Three function sets in 8 bit form put the HD44780 into 8 bit mode whatever it took
+ *			the last nibble for, then it is switched back to 4 bits. Unlike lcd_initialize() this
+ *			neither clears the display nor turns it off, DDRAM keeps what it holds.
+ */
+static void lcd_resync(void)
+{
+    lcd_instruction(0x30);
+    lcd_bus_sleep(5 * 1000, 6 * 1000);
+    lcd_instruction(0x30);
+    lcd_bus_sleep(100, 200);
+    lcd_instruction(0x30);
+    lcd_bus_sleep(100, 200);
+    lcd_instruction(0x20);  // 4 bit mode
+    lcd_bus_sleep(100, 200);
+
+    // function set again, 2 lines and 5x8 font
+    lcd_instruction(0x20);
+    lcd_instruction(0x80);
+}
+
+/*
+ * description:		read LCD_SCRUB_CELLS cells of DDRAM back and rewrite those that differ from the
+ *			mirror. The address counter is read back after setting the address, a panel that
+ *			does not report the address it was given lost the nibble phase and is resynced.
+ *			Noise on the cable is repaired this way without reloading the module or blanking.
+ *			A stale panel is skipped, its DDRAM is not the mirror until the first flush blanks it.
+ */
+static void lcd_scrub_work(struct work_struct *work)
+{
+    struct lcd *pdev = container_of(to_delayed_work(work), struct lcd, scrub_work);
+    unsigned int i, n, row, col, addr;
+    char c;
+    // panels sharing an EN line would all answer the read
+    int shared = lcd_en_shared(pdev->minor);
+
+    mutex_lock(&pdev->frame_lock);
+    mutex_lock(&bus_lock);
+    lcd_bus_select(pdev, 0);
+    for (n = 0; !shared && !pdev->stale && n < LCD_SCRUB_CELLS; n++)
+    {
+        i = pdev->scrub_pos;
+        pdev->scrub_pos = (i + 1) % (NUM_LINES * LCD_PAGES * NUM_CHARS_PER_LINE);
+        row = i / (LCD_PAGES * NUM_CHARS_PER_LINE);
+        col = i % (LCD_PAGES * NUM_CHARS_PER_LINE);
+        addr = LCD_DDRAM_ADDR(row, col);
+
+        lcd_setCursor(row, col);
+        // a slow panel still busy with the address would answer with the old one
+        lcd_bus_wait(bus_wait_us);
+        bus_wait_us = 0;
+        if ((lcd_read_byte(LCD_CMD) & 0x7F) != addr)
+        {
+            printk(KERN_INFO "%s : panel %d lost the nibble phase, resyncing\n", THIS_MODULE->name, pdev->minor);
+            lcd_resync();
+            bus_stats.resyncs++;
+            lcd_setCursor(row, col);
+        }
+
+        lcd_bus_wait(bus_wait_us);
+        bus_wait_us = 0;
+        c = lcd_read_byte(LCD_DATA);
+        // the read moved the address counter on by one, that takes as long as a data write
+        bus_wait_us = bus_timing.data_us;
+        pdev->ac = addr + 1;
+        if (c == pdev->ddram[row][col])
+            continue;
+
+        lcd_setCursor(row, col);
+        lcd_data(pdev->ddram[row][col]);
+        bus_stats.repaired_cells++;
+    }
+    mutex_unlock(&bus_lock);
+    mutex_unlock(&pdev->frame_lock);
+
+    if (READ_ONCE(scrub_ms) != 0)
+        queue_delayed_work(lcd_wq, &pdev->scrub_work, msecs_to_jiffies(READ_ONCE(scrub_ms)));
+}
+
+static void lcd_instruction(char command)
+{
+    lcd_bus_wait(bus_wait_us); // instead of busy checking, the calibrated time of the last transfer
+
+    // Upper 4 bit data (DB7 to DB4) in command mode
+    lcd_write_nibble(command, 0, LCD_CMD);
+    // callers send one nibble at a time, so each one may complete an instruction
+    bus_wait_us = bus_timing.cmd_us;
+}
+
+/*
+ * description:		send a 1-byte ASCII character data to the HD44780 LCD controller.
+ * @param data		a 1-byte data to be sent to the LCD controller. Both the upper 4 bits and the lower 4 bits are used.
+ */
+static void lcd_data(char data)
+{
     // Part 1.  Upper 4 bit data (from bit 7 to bit 4)
-    usleep_range(2000, 3000); // added delay instead of busy checking
+    lcd_bus_wait(bus_wait_us); // instead of busy checking, the calibrated time of the last transfer
+    lcd_write_nibble(data, 0, LCD_DATA);
+
+    // Part 2. Lower 4 bit data (from bit 3 to bit 0), the controller is only busy after this one
+    lcd_write_nibble(data, 1, LCD_DATA);
+    bus_wait_us = bus_timing.data_us;
+}
+
+/*
+ * description:		time until the selected panel drops its busy flag, polled from the end of the last
+ *			nibble. A read takes a few tens of us itself, so this errs on the long side.
+ * @return		us, -1 when the panel is still busy after LCD_BUSY_TIMEOUT_US
+ */
+static int lcd_busy_us(void)
+{
+    ktime_t start = ktime_get();
+    s64 us;
+    int busy;
+
+    do
+    {
+        busy = lcd_read_byte(LCD_CMD) & 0x80;
+        us = ktime_us_delta(ktime_get(), start);
+        if (!busy)
+            return (int)us;
+    } while (us < LCD_BUSY_TIMEOUT_US);
+    return -1;
+}
+
+// worst overshoot of a few usleep_range() calls that ask for exactly LCD_OVERSHOOT_PROBE_US
+static unsigned int lcd_sleep_overshoot(void)
+{
+    ktime_t start;
+    s64 late, worst = 0;
+    int i;
 
-    db7_data = ((data) & (0x1 << 7)) >> (7);
-    db6_data = ((data) & (0x1 << 6)) >> (6);
-    db5_data = ((data) & (0x1 << 5)) >> (5);
-    db4_data = ((data) & (0x1 << 4)) >> (4);
+    for (i = 0; i < LCD_CALIBRATE_RUNS; i++)
+    {
+        start = ktime_get();
+        usleep_range(LCD_OVERSHOOT_PROBE_US, LCD_OVERSHOOT_PROBE_US);
+        late = ktime_us_delta(ktime_get(), start) - LCD_OVERSHOOT_PROBE_US;
+        worst = max(worst, late);
+    }
+    return (unsigned int)worst;
+}
+
+/*
+ * description:		measure how long panel 'minor' is busy after each class of instruction, and how
+ *			late this host wakes up from a sleep. Every class runs LCD_CALIBRATE_RUNS times and
+ *			the longest is kept. Return home stands for the long class, clear display would lose
+ *			DDRAM. Afterwards the display is not shifted, DDRAM address 0 holds 'c' and the address
+ *			counter is 1. Caller holds bus_lock, rw_wired is set and the EN line is not shared.
+ * @return		0, -EIO when the panel never reports ready
+ */
+static int lcd_calibrate(unsigned int minor, char c)
+{
+    struct lcd_timing t = {0, 0, 0};
+    int i, us;
+
+    lcd_bus_select_one(minor);
+    if (lcd_busy_us() < 0)
+        return -EIO;
 
-    gpio_set_value(LCD_D7, db7_data);
-    gpio_set_value(LCD_D6, db6_data);
-    gpio_set_value(LCD_D5, db5_data);
-    gpio_set_value(LCD_D4, db4_data);
+    for (i = 0; i < LCD_CALIBRATE_RUNS; i++)
+    {
+        lcd_write_nibble(0x02, 0, LCD_CMD);     // return home
+        lcd_write_nibble(0x02, 1, LCD_CMD);
+        us = lcd_busy_us();
+        if (us < 0)
+            return -EIO;
+        t.home_us = max_t(unsigned int, t.home_us, us);
 
-    // Part 1. Set to data mode
-    gpio_set_value(LCD_RS, LCD_DATA);
-    usleep_range(5, 10);
+        lcd_write_nibble(0x80, 0, LCD_CMD);     // DDRAM address 0
+        lcd_write_nibble(0x80, 1, LCD_CMD);
+        us = lcd_busy_us();
+        if (us < 0)
+            return -EIO;
+        t.cmd_us = max_t(unsigned int, t.cmd_us, us);
 
-    // Part 1. Simulating falling edge triggered clock
-    gpio_set_value(LCD_EN, 1);
-    usleep_range(5, 10);
-    gpio_set_value(LCD_EN, 0);
+        lcd_write_nibble(c, 0, LCD_DATA);       // what address 0 already holds
+        lcd_write_nibble(c, 1, LCD_DATA);
+        us = lcd_busy_us();
+        if (us < 0)
+            return -EIO;
+        t.data_us = max_t(unsigned int, t.data_us, us);
+    }
 
-    // Part 2. Lower 4 bit data (from bit 3 to bit 0)
-    usleep_range(2000, 3000); // added delay instead of busy checking
+    WRITE_ONCE(timing[minor].cmd_us, t.cmd_us);
+    WRITE_ONCE(timing[minor].data_us, t.data_us);
+    WRITE_ONCE(timing[minor].home_us, t.home_us);
+    WRITE_ONCE(sleep_overshoot_us, lcd_sleep_overshoot());
+    // the panel was just seen ready, and the following transfers already use what was measured
+    bus_wait_us = 0;
+    lcd_bus_timing();
+    printk(KERN_INFO "%s : panel %u busy %u us after a command, %u us after data, %u us after return home, sleeps %u us late\n",
+           THIS_MODULE->name, minor, t.cmd_us, t.data_us, t.home_us, sleep_overshoot_us);
+    return 0;
+}
 
-    db7_data = ((data) & (0x1 << 3)) >> (3);
-    db6_data = ((data) & (0x1 << 2)) >> (2);
-    db5_data = ((data) & (0x1 << 1)) >> (1);
-    db4_data = ((data) & (0x1));
+/*
+ * description:		LCD_CALIBRATE, calibrate a panel in use and redraw what it showed.
+ * @param t		the busy times measured
+ */
+static int lcd_recalibrate(struct lcd *pdev, struct lcd_timing *t)
+{
+    int ret;
 
-    gpio_set_value(LCD_D7, db7_data);
-    gpio_set_value(LCD_D6, db6_data);
-    gpio_set_value(LCD_D5, db5_data);
-    gpio_set_value(LCD_D4, db4_data);
+    if (dry_run || !rw_wired)
+        return -EOPNOTSUPP;
+    // the others on its EN line would answer the busy flag reads as well
+    if (lcd_en_shared(pdev->minor))
+        return -EBUSY;
 
-    // Part 2. Set to data mode
-    gpio_set_value(LCD_RS, LCD_DATA);
-    usleep_range(5, 10);
+    mutex_lock(&pdev->frame_lock);
+    mutex_lock(&bus_lock);
+    ret = lcd_calibrate(pdev->minor, pdev->ddram[0][0]);
+    // where the last instruction left the panel, even after a failure
+    pdev->shift = 0;
+    pdev->page = 0;
+    pdev->ac = (ret == 0) ? 1 : -1;
+    *t = timing[pdev->minor];
+    mutex_unlock(&bus_lock);
+    mutex_unlock(&pdev->frame_lock);
 
-    // Part 2. Simulating falling edge triggered clock
-    gpio_set_value(LCD_EN, 1);
-    usleep_range(5, 10);
-    gpio_set_value(LCD_EN, 0);
+    // the page shown before comes back with the next flush
+    lcd_queue_flush(pdev);
+    return ret;
 }
 
 static void lcd_initialize()
 {
-    usleep_range(41 * 1000, 50 * 1000); // wait for more than 40 ms once the power is on
+    lcd_bus_sleep(41 * 1000, 50 * 1000); // wait for more than 40 ms once the power is on
 
     lcd_instruction(0x30);            // Instruction 0011b (Function set)
-    usleep_range(5 * 1000, 6 * 1000); // wait for more than 4.1 ms
+    lcd_bus_sleep(5 * 1000, 6 * 1000); // wait for more than 4.1 ms
 
     lcd_instruction(0x30);  // Instruction 0011b (Function set)
-    usleep_range(100, 200); // wait for more than 100 us
+    lcd_bus_sleep(100, 200); // wait for more than 100 us
 
     lcd_instruction(0x30);  // Instruction 0011b (Function set)
-    usleep_range(100, 200); // wait for more than 100 us
+    lcd_bus_sleep(100, 200); // wait for more than 100 us
 
     lcd_instruction(0x20);  /* Instruction 0010b (Function set)
                    Set interface to be 4 bits long
                 */
-    usleep_range(100, 200); // wait for more than 100 us
+    lcd_bus_sleep(100, 200); // wait for more than 100 us
 
     lcd_instruction(0x20); // Instruction 0010b (Function set)
     lcd_instruction(0x80); /* Instruction NF**b
                   Set N = 1, or 2-line display
                   Set F = 0, or 5x8 dot character font
                 */
-    usleep_range(41 * 1000, 50 * 1000);
+    lcd_bus_sleep(41 * 1000, 50 * 1000);
 
     /* Display off */
     lcd_instruction(0x00); // Instruction 0000b
     lcd_instruction(0x80); // Instruction 1000b
-    usleep_range(100, 200);
+    lcd_bus_sleep(100, 200);
 
     /* Display clear */
     lcd_instruction(0x00); // Instruction 0000b
     lcd_instruction(0x10); // Instruction 0001b
-    usleep_range(100, 200);
+    lcd_bus_sleep(100, 200);
 
     /* Entry mode set */
     lcd_instruction(0x00); // Instruction 0000b
@@ -478,7 +3645,7 @@ static void lcd_initialize()
                   Set I/D = 1, or increment or decrement DDRAM address by 1
                   Set S = 0, or no display shift
                */
-    usleep_range(100, 200);
+    lcd_bus_sleep(100, 200);
 
     /* Initialization Completed, but set up default LCD setting here */
 
@@ -489,103 +3656,447 @@ static void lcd_initialize()
                   Set C= 1, or Cursor on
                   Set B= 1, or Blinking on
                */
-    usleep_range(100, 200);
+    lcd_bus_sleep(100, 200);
 }
 
-static void lcd_print(struct kfifo *msg, unsigned int lineNumber)
+/*
+ * description:		send cells [first, last) of the frame into DDRAM page 'page'.
+ *			Cells the DDRAM already holds are skipped and the address is only set when the
+ *			HD44780 address counter is not already pointing at the next cell to write.
+ *			In a broadcast a cell is only skipped when every panel of bus_group holds it too.
+ *			Caller holds frame_lock and bus_lock.
+ * @return		number of cells sent to the lcd
+ */
+static unsigned int lcd_flush_page(struct lcd *pdev, unsigned int page, unsigned int first, unsigned int last)
 {
-    int i, ret, len;
-    unsigned int counter = 0;
-    unsigned int lineNum = lineNumber;
-    char buf[fifo_size + 1];
+    unsigned int i, m, row, col, sent = 0;
+
+    for (i = first; i < last; i++)
+    {
+        row = i / NUM_CHARS_PER_LINE;
+        col = page * NUM_CHARS_PER_LINE + i % NUM_CHARS_PER_LINE;
+
+        if (pdev->ddram[row][col] == pdev->frame[i] && lcd_mirror_holds(row, col, pdev->frame[i]))
+            continue;
+
+        if (pdev->ac != LCD_DDRAM_ADDR(row, col))
+            lcd_setCursor(row, col);
+
+        lcd_data(pdev->frame[i]);
+        pdev->ddram[row][col] = pdev->frame[i];
+        for (m = 0; m < bus_group_cnt; m++)
+            bus_group[m]->ddram[row][col] = pdev->frame[i];
+        pdev->ac = LCD_DDRAM_ADDR(row, col) + 1; // I/D = 1, address counter moves to the next cell
+        sent++;
+    }
 
-    printk(KERN_INFO "%s : lcd_print is called\n", THIS_MODULE->name);
+    return sent;
+}
+
+/*
+ * description:		bring cells [first, last) of the frame on the glass.
+ *			Without page flip the visible page is updated in place. With page flip the whole frame
+ *			goes into the hidden page, which still holds an older frame, and is then shifted into
+ *			view, so a redraw never shows up half done.
+ *			Caller holds frame_lock and bus_lock.
+ */
+static void lcd_flush(struct lcd *pdev, unsigned int first, unsigned int last)
+{
+    unsigned int back;
 
-    if (msg == NULL)
+    if (lcd_blank_is_cheaper(pdev))
     {
-        printk(KERN_INFO "%s: kfifo buffer is empty\n", THIS_MODULE->name);
+        lcd_blank(pdev);
         return;
     }
 
-    if ((lineNum != 1) && (lineNum != 2))
+    if (!pdev->page_flip)
     {
-        printk(KERN_DEBUG "ERR: Invalid line number readjusted to 1 \n");
-        lineNum = 1;
+        lcd_flush_page(pdev, pdev->page, first, last);
+        return;
     }
 
-    while (!kfifo_is_empty(msg))
-    {
-        i = 0;
-        len = kfifo_len(msg);
-        printk("inside lcd_print : kfifo_len = %d", len);
-        ret = kfifo_out(msg, buf, len);
-        buf[ret] = '\0';
+    back = (pdev->page + 1) % LCD_PAGES;
+    if (lcd_flush_page(pdev, back, 0, LCD_CELLS) != 0)
+        lcd_present(pdev, back);
+}
 
-        if (lineNum == 1)
+/*
+ * description:		make DDRAM page 'page' the visible one.
+ *			Page 0 is one return home instruction. Other pages are reached with display shift
+ *			instructions, which only take 37 us each and are sent back to back, so the whole
+ *			switch is done in far less time than the liquid crystal needs to respond.
+ */
+static void lcd_present(struct lcd *pdev, unsigned int page)
+{
+    unsigned int target = page * NUM_CHARS_PER_LINE;
+    unsigned int left;
+
+    if (target == 0)
+    {
+        if (pdev->shift != 0)
+        {
+            lcd_returnHome();
+            pdev->ac = 0; // return home also sets the address counter to 0
+        }
+    }
+    else
+    {
+        // shift left moves the window one DDRAM column to the right, shift right one to the left
+        left = (target + LCD_DDRAM_COLS - pdev->shift) % LCD_DDRAM_COLS;
+        if (left <= LCD_DDRAM_COLS / 2)
         {
-            lcd_setLinePosition(LCD_LINE_NUM_ONE);
+            while (left-- > 0)
+                lcd_fast_command(0x18);
         }
         else
         {
-            lcd_setLinePosition(LCD_LINE_NUM_TWO);
+            for (left = LCD_DDRAM_COLS - left; left > 0; left--)
+                lcd_fast_command(0x1C);
         }
+    }
+    pdev->shift = target;
+    pdev->page = page;
+}
+
+// a blank frame over more than one visible character is cheaper as one clear instruction
+static int lcd_blank_is_cheaper(struct lcd *pdev)
+{
+    unsigned int i, diff = 0;
+
+    for (i = 0; i < LCD_CELLS; i++)
+    {
+        if (pdev->frame[i] != ' ')
+            return 0;
+        if (pdev->ddram[i / NUM_CHARS_PER_LINE][pdev->page * NUM_CHARS_PER_LINE + i % NUM_CHARS_PER_LINE] != ' ')
+            diff++;
+    }
+    return diff > 1;
+}
+
+/*
+ * description:		blank the lcd with a single clear instruction.
+ *			Caller holds frame_lock and bus_lock.
+ */
+static void lcd_blank(struct lcd *pdev)
+{
+    unsigned int i;
+
+    lcd_clearDisplay();
+    memset(pdev->ddram, ' ', sizeof(pdev->ddram));
+    for (i = 0; i < bus_group_cnt; i++)
+        memset(bus_group[i]->ddram, ' ', sizeof(bus_group[i]->ddram));
+    pdev->ac = 0; // clear display also returns the address counter to 0
+    pdev->shift = 0; // and undoes the display shift
+    pdev->page = 0;
+}
+
+static void lcd_screen_clear(struct lcd_screen *scr)
+{
+    memset(scr->cells, ' ', sizeof(scr->cells));
+    scr->term.row = 0;
+    scr->term.col = 0;
+}
+
+// number of cells in a window of the panel
+static unsigned int lcd_region_size(const struct lcd_region *win)
+{
+    return win->width * win->height;
+}
 
-        for (i = 0; buf[i] != '\0'; i++)
+// panel cell of window position 'pos', positions count row by row inside the window
+static unsigned int lcd_region_cell(const struct lcd_region *win, unsigned int pos)
+{
+    return (win->row + pos / win->width) * NUM_CHARS_PER_LINE + win->col + pos % win->width;
+}
+
+static void lcd_term_reset(struct lcd_term *term)
+{
+    memset(term, 0, sizeof(*term));
+    term->state = LCD_TERM_NORMAL;
+}
+
+// blank window positions [first, last) of the screen
+static void lcd_term_erase(struct lcd_screen *scr, unsigned int first, unsigned int last)
+{
+    for (; first < last; first++)
+        scr->cells[lcd_region_cell(&scr->win, first)] = ' ';
+}
+
+// move the cursor to the start of the next line, scrolling the frame up on the last line
+static void lcd_term_newline(struct lcd_screen *scr)
+{
+    struct lcd_term *term = &scr->term;
+    unsigned int row;
+
+    term->col = 0;
+    if (term->row + 1 < scr->win.height)
+    {
+        term->row++;
+        return;
+    }
+    for (row = 0; row + 1 < scr->win.height; row++)
+        memcpy(scr->cells + lcd_region_cell(&scr->win, row * scr->win.width),
+               scr->cells + lcd_region_cell(&scr->win, (row + 1) * scr->win.width), scr->win.width);
+    lcd_term_erase(scr, lcd_region_size(&scr->win) - scr->win.width, lcd_region_size(&scr->win));
+}
+
+// CSI parameter 'n' or 'def' when it is missing or 0
+static unsigned int lcd_term_param(struct lcd_term *term, unsigned int n, unsigned int def)
+{
+    if (n >= term->nparam || term->param[n] == 0)
+        return def;
+    return term->param[n];
+}
+
+// execute the CSI sequence ending with 'final'
+static void lcd_term_csi(struct lcd_screen *scr, char final)
+{
+    struct lcd_term *term = &scr->term;
+    unsigned int cur = term->row * scr->win.width + term->col;
+    unsigned int line = term->row * scr->win.width;
+    unsigned int n = lcd_term_param(term, 0, 1);
+
+    // a pending wrap (col == scr->win.width) counts as the last column for erasing and moving
+    if (term->col >= scr->win.width)
+        cur = line + scr->win.width - 1;
+
+    switch (final)
+    {
+    case 'H': // CUP, row;col counted from 1
+    case 'f':
+        term->row = min_t(unsigned int, lcd_term_param(term, 0, 1), scr->win.height) - 1;
+        term->col = min_t(unsigned int, lcd_term_param(term, 1, 1), scr->win.width) - 1;
+        break;
+    case 'A': // CUU
+        term->row = (n > term->row) ? 0 : term->row - n;
+        break;
+    case 'B': // CUD
+        term->row = min_t(unsigned int, term->row + n, scr->win.height - 1);
+        break;
+    case 'C': // CUF
+        term->col = min_t(unsigned int, term->col + n, scr->win.width - 1);
+        break;
+    case 'D': // CUB
+        term->col = min_t(unsigned int, term->col, scr->win.width - 1);
+        term->col = (n > term->col) ? 0 : term->col - n;
+        break;
+    case 'G': // CHA
+        term->col = min_t(unsigned int, n, scr->win.width) - 1;
+        break;
+    case 'J': // ED, 0 cursor to end, 1 start to cursor, 2 whole screen
+        switch (lcd_term_param(term, 0, 0))
         {
-            if (counter >= NUM_CHARS_PER_LINE)
-            {
-                if (lineNum == 1)
-                {
-                    lineNum = 2;
-                    lcd_setLinePosition(LCD_LINE_NUM_TWO);
-                    counter = 0;
-                }
-                else
-                    break;
-            }
-            lcd_data(buf[i]);
-            counter++;
+        case 0:
+            lcd_term_erase(scr, cur, lcd_region_size(&scr->win));
+            break;
+        case 1:
+            lcd_term_erase(scr, 0, cur + 1);
+            break;
+        default:
+            lcd_term_erase(scr, 0, lcd_region_size(&scr->win));
+            break;
         }
-
-        if (counter >= NUM_CHARS_PER_LINE)
+        break;
+    case 'K': // EL, 0 cursor to end of line, 1 start of line to cursor, 2 whole line
+        switch (lcd_term_param(term, 0, 0))
         {
-            printk(KERN_INFO "%s : Data inside the kfifo more then 32 character\n", THIS_MODULE->name);
+        case 0:
+            lcd_term_erase(scr, cur, line + scr->win.width);
+            break;
+        case 1:
+            lcd_term_erase(scr, line, cur + 1);
+            break;
+        default:
+            lcd_term_erase(scr, line, line + scr->win.width);
             break;
         }
+        break;
+    case 's':
+        term->saved_row = term->row;
+        term->saved_col = term->col;
+        break;
+    case 'u':
+        term->row = term->saved_row;
+        term->col = term->saved_col;
+        break;
+    default: // SGR and everything else the panel can not show is ignored
+        break;
     }
 }
 
-static void lcd_setLinePosition(unsigned int line)
+/*
+ * description:		run one byte of the stream through the VT100 subset parser.
+ *			Printable characters land in the frame at the cursor, control characters and
+ *			escape sequences move the cursor or blank cells. Nothing is sent to the lcd here.
+ */
+static void lcd_term_putc(struct lcd_screen *scr, char c)
 {
-    if (line == 1)
+    struct lcd_term *term = &scr->term;
+
+    switch (term->state)
     {
-        lcd_instruction(0x80); // set position to LCD line 1
-        lcd_instruction(0x00);
+    case LCD_TERM_ESC:
+        term->state = LCD_TERM_NORMAL;
+        if (c == '[')
+        {
+            term->state = LCD_TERM_CSI;
+            term->nparam = 0;
+            memset(term->param, 0, sizeof(term->param));
+        }
+        else if (c == '7')
+        {
+            term->saved_row = term->row;
+            term->saved_col = term->col;
+        }
+        else if (c == '8')
+        {
+            term->row = term->saved_row;
+            term->col = term->saved_col;
+        }
+        else if (c == 'c')
+        {
+            lcd_term_erase(scr, 0, lcd_region_size(&scr->win));
+            lcd_term_reset(term);
+        }
+        return;
+
+    case LCD_TERM_CSI:
+        if (c >= '0' && c <= '9')
+        {
+            if (term->nparam == 0)
+                term->nparam = 1;
+            if (term->nparam <= LCD_TERM_MAX_PARAMS && term->param[term->nparam - 1] < 1000)
+                term->param[term->nparam - 1] = term->param[term->nparam - 1] * 10 + (c - '0');
+        }
+        else if (c == ';')
+        {
+            if (term->nparam == 0)
+                term->nparam = 1;
+            if (term->nparam < LCD_TERM_MAX_PARAMS + 1)
+                term->nparam++;
+        }
+        else if (c >= 0x40 && c <= 0x7E)
+        {
+            term->nparam = min_t(unsigned int, term->nparam, LCD_TERM_MAX_PARAMS);
+            lcd_term_csi(scr, c);
+            term->state = LCD_TERM_NORMAL;
+        }
+        // intermediate and private marker bytes ('?', ' ' ...) are skipped
+        return;
+
+    default:
+        break;
     }
-    else if (line == 2)
+
+    switch (c)
     {
-        lcd_instruction(0xC0);
-        lcd_instruction(0x00);
+    case '\033':
+        term->state = LCD_TERM_ESC;
+        break;
+    case '\r':
+        term->col = 0;
+        break;
+    case '\n': // no tty in front of the device, so LF also returns the carriage
+        lcd_term_newline(scr);
+        break;
+    case '\b':
+        if (term->col > 0)
+            term->col = min_t(unsigned int, term->col, scr->win.width) - 1;
+        break;
+    case '\t':
+        term->col = min_t(unsigned int, (term->col + 8) & ~7u, scr->win.width - 1);
+        break;
+    default:
+        if ((unsigned char)c < 0x20 || c == 0x7F)
+            break;
+        // the wrap is done when the next character arrives, like a VT100
+        if (term->col >= scr->win.width)
+            lcd_term_newline(scr);
+        scr->cells[lcd_region_cell(&scr->win, term->row * scr->win.width + term->col)] = c;
+        term->col++;
+        break;
     }
-    else
+}
+
+/*
+ * description:		write the glyphs changed since the last flush into CGRAM of the selected panels.
+ *			The cells showing a glyph change with it, DDRAM is not touched. Glyphs next to each
+ *			other share one set CGRAM address. A follower keeps its glyphs until it leads.
+ *			Caller holds frame_lock of pdev and bus_lock.
+ */
+static void lcd_load_glyphs(struct lcd *pdev)
+{
+    unsigned int g, r;
+    unsigned char cmd;
+    int next = -1;  // glyph the CGRAM address counter points at
+
+    if (pdev->glyph_dirty == 0)
+        return;
+    for (g = 0; g < LCD_GLYPHS; g++)
     {
-        printk(KERN_INFO "%s: Invalid line number. Select either 1 or 2 \n", THIS_MODULE->name);
+        if (!(pdev->glyph_dirty & BV(g)))
+            continue;
+        if (next != (int)g)
+        {
+            // Set CGRAM address instruction (01AAAAAAb), sent upper nibble first
+            cmd = 0x40 | (g * LCD_GLYPH_ROWS);
+            lcd_instruction(cmd & 0xF0);
+            lcd_instruction((cmd << 4) & 0xF0);
+        }
+        for (r = 0; r < LCD_GLYPH_ROWS; r++)
+            lcd_data(pdev->glyphs[g][r] & 0x1F);
+        next = g + 1;
     }
+    pdev->glyph_dirty = 0;
+    // the address counter points into CGRAM now, the next cell sets the DDRAM address again
+    pdev->ac = -1;
+}
+
+static void lcd_setCursor(unsigned int row, unsigned int col)
+{
+    // Set DDRAM address instruction (1AAAAAAAb), sent upper nibble first
+    unsigned char cmd = 0x80 | LCD_DDRAM_ADDR(row, col);
+
+    lcd_instruction(cmd & 0xF0);
+    lcd_instruction((cmd << 4) & 0xF0);
 }
 
 static void lcd_clearDisplay(void)
 {
     lcd_instruction(0x00); // upper 4 bits of command
     lcd_instruction(0x10); // lower 4 bits of command
+    bus_wait_us = bus_timing.home_us;
 
     printk(KERN_INFO "%s: display clear\n", THIS_MODULE->name);
 }
 
+// Return home instruction (0x02), takes 1.52 ms which the next lcd_instruction() waits out
+static void lcd_returnHome(void)
+{
+    lcd_instruction(0x00);
+    lcd_instruction(0x20);
+    bus_wait_us = bus_timing.home_us;
+}
+
+/*
+ * description:		send a display shift as two back to back nibbles. The first one waits out the previous
+ *			transfer, the ones after it only bus_fast_us, the datasheet 37 us on a panel that was
+ *			not calibrated. Not for clear display or return home, they take 1.52 ms.
+ */
+static void lcd_fast_command(unsigned char command)
+{
+    lcd_bus_wait(bus_wait_us); // a shift may follow a data write, which has its own time
+    lcd_write_nibble(command, 0, LCD_CMD);
+    lcd_write_nibble(command, 1, LCD_CMD);
+    bus_wait_us = bus_fast_us;
+}
+
 static void lcd_shift_left(void)
 {
     lcd_instruction(0x10);
     lcd_instruction(0x80);
-    usleep_range(10,20);
+    lcd_bus_sleep(10,20);
     printk(KERN_INFO "%s: lcd_shift left is called\n", THIS_MODULE->name);
 }
 
@@ -593,7 +4104,7 @@ static void lcd_shift_right(void)
 {
     lcd_instruction(0x10);
     lcd_instruction(0xC0);
-    usleep_range(10,20);
+    lcd_bus_sleep(10,20);
     printk(KERN_INFO "%s: lcd_shift right is called\n", THIS_MODULE->name);
 }
 
@@ -603,4 +4114,7 @@ module_exit(lcd_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Parth");
-MODULE_DESCRIPTION("This kernel module is for lcd");
\ No newline at end of file
+MODULE_DESCRIPTION("This kernel module is for lcd");
+#ifdef BBB_LCD_KUNIT_TEST
+#include "lcd_multi_test.c"
+#endif
@@ -0,0 +1,412 @@
+/*
+ * KUnit suite of lcd_multi, built into lcd_multi.ko with CONFIG_BBB_LCD_KUNIT_TEST (see Kbuild).
+ * It is included at the end of lcd_multi.c so it reaches the static functions of the driver.
+ *
+ * The bus cases run the driver on a recording bus: dry_run keeps the pins untouched and the
+ * capture ring of the driver is pointed at a buffer of the test, so every nibble lcd_write_nibble()
+ * sends is recorded and decoded back into instructions and characters. The bus runs on the fixed
+ * lcd_test_timing and starts idle, so the bus time bus_stats models for a case is known exactly.
+ * The mmio case hands lcd_mmio_nibble() a zeroed block in place of the GPIO banks.
+ */
+#include <kunit/test.h>
+
+#define LCD_TEST_RECS       512     // nibbles a case may send
+#define LCD_TEST_BYTES      (LCD_TEST_RECS / 2)
+#define LCD_TEST_NIBBLE_US  10      // a dry_run strobe, two lcd_bus_sleep(5, 10)
+#define LCD_TEST_SHIFT_US   10      // the settle lcd_shift_left()/lcd_shift_right() sleep after a shift
+#define LCD_TEST_WRAP_LEN   20      // a write longer than a row
+
+// busy times the bus runs on, all different so a wait for the wrong one shows up in bus_us
+static const struct lcd_timing lcd_test_timing = {37, 41, 1520};
+
+// what a case sent, decoded from the recorded nibbles
+struct lcd_test_log
+{
+    unsigned int cmd_nibbles, data_nibbles;     // from the records
+    unsigned long long stat_cmd, stat_data;     // the same from bus_stats
+    unsigned long long bus_us;                  // modelled bus time from bus_stats
+    unsigned int ninstr, ndata;
+    unsigned char instr[LCD_TEST_BYTES];
+    unsigned char data[LCD_TEST_BYTES];
+    int split;                                  // a byte whose nibbles had different RS
+};
+
+// driver state the recording bus replaces, put back by lcd_test_bus_end()
+struct lcd_test_bus
+{
+    bool dry_run;
+    struct lcd_capture_rec *capture;
+    unsigned int capture_len;
+    unsigned long long capture_head;
+    struct lcd_bus_stats stats;
+    unsigned int wait_us;
+    struct lcd_timing timing;
+    unsigned int fast_us;
+};
+
+static struct lcd_capture_rec lcd_test_recs[LCD_TEST_RECS];
+static struct lcd_test_bus lcd_test_saved;
+
+/*
+ * description:		take the bus and switch it to recording, with pdev selected.
+ *			Holds dev_lock and bus_lock until lcd_test_bus_end(), so a case only uses
+ *			KUNIT_EXPECT_* in between, an assertion would leave the locks taken.
+ */
+static void lcd_test_bus_begin(struct lcd *pdev)
+{
+    mutex_lock(&dev_lock);
+    mutex_lock(&bus_lock);
+    lcd_test_saved.dry_run = dry_run;
+    lcd_test_saved.capture = capture;
+    lcd_test_saved.capture_len = capture_len;
+    lcd_test_saved.capture_head = capture_head;
+    lcd_test_saved.stats = bus_stats;
+    lcd_test_saved.wait_us = bus_wait_us;
+    lcd_test_saved.timing = bus_timing;
+    lcd_test_saved.fast_us = bus_fast_us;
+
+    dry_run = true;
+    capture = lcd_test_recs;
+    capture_len = LCD_TEST_RECS;
+    capture_head = 0;
+    memset(&bus_stats, 0, sizeof(bus_stats));
+    lcd_bus_select(pdev, 0);
+    // whatever the panels calibrated to, the case runs on lcd_test_timing from an idle bus
+    bus_timing = lcd_test_timing;
+    bus_fast_us = lcd_test_timing.cmd_us;
+    bus_wait_us = 0;
+}
+
+// decode what was recorded since lcd_test_bus_begin() into 'log' and give the bus back
+static void lcd_test_bus_end(struct lcd_test_log *log)
+{
+    unsigned int i, n = min_t(unsigned long long, capture_head, LCD_TEST_RECS);
+    unsigned char byte;
+
+    memset(log, 0, sizeof(*log));
+    for (i = 0; i < n; i++)
+    {
+        if (lcd_test_recs[i].flags & LCD_CAP_RS)
+            log->data_nibbles++;
+        else
+            log->cmd_nibbles++;
+    }
+    // the driver is in 4 bit mode, every two nibbles make one byte
+    for (i = 0; i + 1 < n; i += 2)
+    {
+        byte = (lcd_test_recs[i].nibble << 4) | lcd_test_recs[i + 1].nibble;
+        if ((lcd_test_recs[i].flags ^ lcd_test_recs[i + 1].flags) & LCD_CAP_RS)
+            log->split = 1;
+        if (lcd_test_recs[i].flags & LCD_CAP_RS)
+            log->data[log->ndata++] = byte;
+        else
+            log->instr[log->ninstr++] = byte;
+    }
+    if (n % 2)
+        log->split = 1;
+    log->stat_cmd = bus_stats.cmd_nibbles;
+    log->stat_data = bus_stats.data_nibbles;
+    log->bus_us = bus_stats.bus_us;
+
+    dry_run = lcd_test_saved.dry_run;
+    capture = lcd_test_saved.capture;
+    capture_len = lcd_test_saved.capture_len;
+    capture_head = lcd_test_saved.capture_head;
+    bus_stats = lcd_test_saved.stats;
+    bus_wait_us = lcd_test_saved.wait_us;
+    bus_timing = lcd_test_saved.timing;
+    bus_fast_us = lcd_test_saved.fast_us;
+    mutex_unlock(&bus_lock);
+    mutex_unlock(&dev_lock);
+}
+
+// checks every case makes on what it sent
+static void lcd_test_expect_log(struct kunit *test, const struct lcd_test_log *log,
+                                unsigned int ninstr, unsigned int ndata, unsigned int bus_us)
+{
+    KUNIT_EXPECT_FALSE(test, log->split);
+    KUNIT_EXPECT_EQ(test, log->ninstr, ninstr);
+    KUNIT_EXPECT_EQ(test, log->ndata, ndata);
+    KUNIT_EXPECT_EQ(test, log->cmd_nibbles, 2 * ninstr);
+    KUNIT_EXPECT_EQ(test, log->data_nibbles, 2 * ndata);
+    // bus_stats counts the same nibbles the recording saw
+    KUNIT_EXPECT_EQ(test, log->stat_cmd, (unsigned long long)log->cmd_nibbles);
+    KUNIT_EXPECT_EQ(test, log->stat_data, (unsigned long long)log->data_nibbles);
+    KUNIT_EXPECT_EQ(test, log->bus_us, (unsigned long long)bus_us);
+}
+
+// a panel of minor 0 as lcd_get() leaves it, blank with the address counter unknown
+static int lcd_test_init(struct kunit *test)
+{
+    struct lcd *pdev;
+
+    // the cases need the module state lcd_init() sets up, on a board without the pins load it with dry_run=1
+    if (dev == NULL || timing == NULL)
+        kunit_skip(test, "lcd_multi did not initialise, dry_run=1 runs it without the pins");
+
+    pdev = kunit_kzalloc(test, sizeof(*pdev), GFP_KERNEL);
+    if (pdev == NULL)
+        return -ENOMEM;
+    mutex_init(&pdev->frame_lock);
+    pdev->minor = 0;
+    pdev->en = lcd_en_of(0);
+    pdev->ac = -1;
+    memset(pdev->frame, ' ', sizeof(pdev->frame));
+    memset(pdev->ddram, ' ', sizeof(pdev->ddram));
+    test->priv = pdev;
+    return 0;
+}
+
+// the frame is already on the panel
+static void lcd_test_shown(struct lcd *pdev, const char *text)
+{
+    unsigned int i;
+
+    memcpy(pdev->frame, text, LCD_CELLS);
+    for (i = 0; i < LCD_CELLS; i++)
+        pdev->ddram[i / NUM_CHARS_PER_LINE][i % NUM_CHARS_PER_LINE] = text[i];
+}
+
+static const char lcd_test_text[LCD_CELLS + 1] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ012345";
+
+/*
+ * description:		bus time of a flush from an idle bus that sets the address of each of 'rows' rows
+ *			and then writes 'cells[row]' characters there. The set address is two lcd_instruction()
+ *			nibbles, the first waits out the data write before it (nothing on the first row), the
+ *			second the first one. The first character waits out the set address, the others the
+ *			character before them.
+ */
+static unsigned int lcd_test_rows_us(unsigned int rows, const unsigned int *cells)
+{
+    unsigned int r, us = 0;
+
+    for (r = 0; r < rows; r++)
+    {
+        us += (r ? lcd_test_timing.data_us : 0) + lcd_test_timing.cmd_us + 2 * LCD_TEST_NIBBLE_US;
+        us += lcd_test_timing.cmd_us + (cells[r] - 1) * lcd_test_timing.data_us + cells[r] * 2 * LCD_TEST_NIBBLE_US;
+    }
+    return us;
+}
+
+// a whole new frame costs one address per row and every character once
+static void lcd_test_full_write(struct kunit *test)
+{
+    struct lcd *pdev = test->priv;
+    struct lcd_test_log log;
+    static const unsigned int cells[] = {NUM_CHARS_PER_LINE, NUM_CHARS_PER_LINE};
+
+    memcpy(pdev->frame, lcd_test_text, LCD_CELLS);
+    lcd_test_bus_begin(pdev);
+    lcd_flush(pdev, 0, LCD_CELLS);
+    lcd_test_bus_end(&log);
+
+    lcd_test_expect_log(test, &log, 2, LCD_CELLS, lcd_test_rows_us(2, cells));
+    KUNIT_EXPECT_EQ(test, log.instr[0], 0x80);
+    KUNIT_EXPECT_EQ(test, log.instr[1], 0xC0);
+    KUNIT_EXPECT_MEMEQ(test, log.data, lcd_test_text, LCD_CELLS);
+    KUNIT_EXPECT_EQ(test, pdev->ac, LCD_DDRAM_ADDR(1, NUM_CHARS_PER_LINE));
+}
+
+// one changed cell is one set address and one character, the rest of the frame is skipped
+static void lcd_test_single_cell(struct kunit *test)
+{
+    struct lcd *pdev = test->priv;
+    struct lcd_test_log log;
+    static const unsigned int cells[] = {1};
+
+    lcd_test_shown(pdev, lcd_test_text);
+    pdev->frame[5] = 'x';
+    lcd_test_bus_begin(pdev);
+    lcd_flush(pdev, 0, LCD_CELLS);
+    lcd_test_bus_end(&log);
+
+    lcd_test_expect_log(test, &log, 1, 1, lcd_test_rows_us(1, cells));
+    KUNIT_EXPECT_EQ(test, log.instr[0], 0x80 | LCD_DDRAM_ADDR(0, 5));
+    KUNIT_EXPECT_EQ(test, log.data[0], 'x');
+
+    // the address counter is already on the next cell, no set address this time and nothing to wait for
+    pdev->frame[6] = 'y';
+    lcd_test_bus_begin(pdev);
+    lcd_flush(pdev, 0, LCD_CELLS);
+    lcd_test_bus_end(&log);
+
+    lcd_test_expect_log(test, &log, 0, 1, 2 * LCD_TEST_NIBBLE_US);
+    KUNIT_EXPECT_EQ(test, log.data[0], 'y');
+}
+
+/*
+ * description:		LCD_SHIFT_LEFT/LCD_SHIFT_RIGHT by N are N shift instructions and nothing else.
+ *			Each shift is two lcd_instruction() nibbles and a settle sleep, every nibble but
+ *			the very first waits out the instruction time.
+ */
+static void lcd_test_shift(struct kunit *test)
+{
+    struct lcd *pdev = test->priv;
+    struct lcd_test_log log;
+    unsigned int i;
+    const unsigned int left = 3, right = 2, n = left + right;
+
+    lcd_test_bus_begin(pdev);
+    for (i = 0; i < left; i++)
+        lcd_shift_left();
+    for (i = 0; i < right; i++)
+        lcd_shift_right();
+    lcd_test_bus_end(&log);
+
+    lcd_test_expect_log(test, &log, n, 0,
+                        n * (2 * LCD_TEST_NIBBLE_US + LCD_TEST_SHIFT_US) + (2 * n - 1) * lcd_test_timing.cmd_us);
+    for (i = 0; i < left; i++)
+        KUNIT_EXPECT_EQ(test, log.instr[i], 0x18);
+    for (i = left; i < n; i++)
+        KUNIT_EXPECT_EQ(test, log.instr[i], 0x1C);
+}
+
+// the last cell of row 0 and the first of row 1 are not adjacent in DDRAM, the address is set again
+static void lcd_test_row_wrap(struct kunit *test)
+{
+    struct lcd *pdev = test->priv;
+    struct lcd_test_log log;
+
+    lcd_test_shown(pdev, lcd_test_text);
+    pdev->frame[NUM_CHARS_PER_LINE - 1] = '<';
+    pdev->frame[NUM_CHARS_PER_LINE] = '>';
+    lcd_test_bus_begin(pdev);
+    lcd_flush(pdev, 0, LCD_CELLS);
+    lcd_test_bus_end(&log);
+
+    // the second set address waits out '<', then itself, like the next row of a flush
+    lcd_test_expect_log(test, &log, 2, 2,
+                        8 * LCD_TEST_NIBBLE_US + 4 * lcd_test_timing.cmd_us + lcd_test_timing.data_us);
+    KUNIT_EXPECT_EQ(test, log.instr[0], 0x80 | LCD_DDRAM_ADDR(0, NUM_CHARS_PER_LINE - 1));
+    KUNIT_EXPECT_EQ(test, log.instr[1], 0x80 | LCD_DDRAM_ADDR(1, 0));
+    KUNIT_EXPECT_EQ(test, log.data[0], '<');
+    KUNIT_EXPECT_EQ(test, log.data[1], '>');
+}
+
+// a LCD_TEST_WRAP_LEN character write at offset 0 of a full panel window fills row 0 and runs on into row 1
+static void lcd_test_write_wrap(struct kunit *test)
+{
+    struct lcd *pdev = test->priv;
+    struct lcd_test_log log;
+    const struct lcd_region win = {0, 0, NUM_CHARS_PER_LINE, NUM_LINES};
+    const unsigned int len = LCD_TEST_WRAP_LEN;
+    static const unsigned int cells[] = {NUM_CHARS_PER_LINE, LCD_TEST_WRAP_LEN - NUM_CHARS_PER_LINE};
+    unsigned int i;
+
+    // the cells lcd_write() puts the characters in
+    for (i = 0; i < len; i++)
+        pdev->frame[lcd_region_cell(&win, i)] = lcd_test_text[i];
+    lcd_test_bus_begin(pdev);
+    lcd_flush(pdev, 0, LCD_CELLS);
+    lcd_test_bus_end(&log);
+
+    lcd_test_expect_log(test, &log, 2, len, lcd_test_rows_us(2, cells));
+    KUNIT_EXPECT_EQ(test, log.instr[0], 0x80 | LCD_DDRAM_ADDR(0, 0));
+    KUNIT_EXPECT_EQ(test, log.instr[1], 0x80 | LCD_DDRAM_ADDR(1, 0));
+    KUNIT_EXPECT_MEMEQ(test, log.data, lcd_test_text, len);
+    // the rest of row 1 was blank already and stays untouched
+    KUNIT_EXPECT_EQ(test, pdev->ac, LCD_DDRAM_ADDR(1, len - NUM_CHARS_PER_LINE));
+}
+
+// the SETDATAOUT/CLEARDATAOUT words for 'nib' and 'rs', worked out pin by pin rather than from lcd_byte_mask
+static void lcd_test_masks(unsigned char nib, int rs, unsigned int set[LCD_GPIO_BANKS], unsigned int clr[LCD_GPIO_BANKS])
+{
+    static const int data_pin[] = {LCD_D4, LCD_D5, LCD_D6, LCD_D7};
+    unsigned int k;
+
+    memset(set, 0, LCD_GPIO_BANKS * sizeof(set[0]));
+    memset(clr, 0, LCD_GPIO_BANKS * sizeof(clr[0]));
+    for (k = 0; k < ARRAY_SIZE(data_pin); k++)
+    {
+        if (nib & (1 << k))
+            set[LCD_GPIO_BANK(data_pin[k])] |= LCD_GPIO_BIT(data_pin[k]);
+        else
+            clr[LCD_GPIO_BANK(data_pin[k])] |= LCD_GPIO_BIT(data_pin[k]);
+    }
+    if (rs)
+        set[LCD_GPIO_BANK(LCD_RS)] |= LCD_GPIO_BIT(LCD_RS);
+    else
+        clr[LCD_GPIO_BANK(LCD_RS)] |= LCD_GPIO_BIT(LCD_RS);
+}
+
+/*
+ * description:		every byte, nibble and RS through lcd_mmio_nibble() into a zeroed block of
+ *			LCD_GPIO_BANKS banks. The driver never stores a zero mask, so the words that
+ *			are not zero afterwards are the stores it made, at most one per register.
+ */
+static void lcd_test_mmio_nibble(struct kunit *test)
+{
+    void __iomem *bank[LCD_GPIO_BANKS];
+    unsigned int set[LCD_GPIO_BANKS], clr[LCD_GPIO_BANKS];
+    unsigned int byte, b, w, stores, expected;
+    unsigned char nib;
+    int half, rs;
+    u32 *regs;
+
+    regs = kunit_kzalloc(test, LCD_GPIO_BANKS * GPIO_BANK_SIZE, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, regs);
+    for (b = 0; b < LCD_GPIO_BANKS; b++)
+        bank[b] = (void __iomem __force *)((char *)regs + b * GPIO_BANK_SIZE);
+
+    for (byte = 0; byte < 256; byte++)
+    {
+        for (half = 0; half < 2; half++)
+        {
+            nib = half ? (byte & 0x0F) : (byte >> 4);
+            for (rs = 0; rs < 2; rs++)
+            {
+                memset(regs, 0, LCD_GPIO_BANKS * GPIO_BANK_SIZE);
+                lcd_mmio_nibble(bank, (unsigned char)byte, half, rs);
+                lcd_test_masks(nib, rs, set, clr);
+
+                expected = 0;
+                for (b = 0; b < LCD_GPIO_BANKS; b++)
+                {
+                    // the table itself, without RS
+                    KUNIT_EXPECT_EQ_MSG(test, lcd_byte_mask[byte].nib[half][b].set | (set[b] & LCD_PIN_MASK(LCD_RS, b)),
+                                        set[b], "byte 0x%02x half %d bank %u", byte, half, b);
+                    KUNIT_EXPECT_EQ_MSG(test, lcd_byte_mask[byte].nib[half][b].clr | (clr[b] & LCD_PIN_MASK(LCD_RS, b)),
+                                        clr[b], "byte 0x%02x half %d bank %u", byte, half, b);
+                    // and what was stored
+                    KUNIT_EXPECT_EQ_MSG(test, regs[(b * GPIO_BANK_SIZE + GPIO_SETDATAOUT) / 4], set[b],
+                                        "byte 0x%02x half %d rs %d bank %u", byte, half, rs, b);
+                    KUNIT_EXPECT_EQ_MSG(test, regs[(b * GPIO_BANK_SIZE + GPIO_CLEARDATAOUT) / 4], clr[b],
+                                        "byte 0x%02x half %d rs %d bank %u", byte, half, rs, b);
+                    KUNIT_EXPECT_EQ(test, set[b] & clr[b], 0u);
+                    expected += (set[b] != 0) + (clr[b] != 0);
+                }
+
+                stores = 0;
+                for (w = 0; w < LCD_GPIO_BANKS * GPIO_BANK_SIZE / 4; w++)
+                    stores += (regs[w] != 0);
+                KUNIT_EXPECT_EQ_MSG(test, stores, expected, "byte 0x%02x half %d rs %d", byte, half, rs);
+            }
+        }
+    }
+}
+
+static struct kunit_case lcd_mmio_cases[] = {
+    KUNIT_CASE(lcd_test_mmio_nibble),
+    {}
+};
+
+static struct kunit_suite lcd_mmio_suite = {
+    .name = "bbb_lcd_mmio",
+    .test_cases = lcd_mmio_cases,
+};
+
+static struct kunit_case lcd_bus_cases[] = {
+    KUNIT_CASE(lcd_test_full_write),
+    KUNIT_CASE(lcd_test_single_cell),
+    KUNIT_CASE(lcd_test_shift),
+    KUNIT_CASE(lcd_test_row_wrap),
+    KUNIT_CASE(lcd_test_write_wrap),
+    {}
+};
+
+static struct kunit_suite lcd_bus_suite = {
+    .name = "bbb_lcd_bus",
+    .init = lcd_test_init,
+    .test_cases = lcd_bus_cases,
+};
+kunit_test_suites(&lcd_mmio_suite, &lcd_bus_suite);
@@ -4,15 +4,31 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
-#include "bbb_lcd.h"
+#include <sys/uio.h>
+#include "bbb_lcd_hw.h"
 #include "bbb_ioctl.h"
 
-int main(int argc, void *argv[])
+int main(int argc, char *argv[])
 {
-    int choice, len, fd, ret, shift;
+    int choice, len, fd, ret, shift, flags;
+    off_t offset;
+    struct lcd_region region;
+    struct lcd_snapshot snap;
+    struct lcd_seq seq;
+    struct lcd_widget_req widget;
+    struct lcd_bus_stats stats;
+    struct lcd_anim_frame frames[4];
+    struct lcd_anim anim;
+    struct iovec iov[2];
+    struct lcd_timing timing;
+    int i;
     char buf[BUF_SIZE];
 
-    fd = open("/dev/bbb_lcd0", O_WRONLY);
+    choice = atoi(argv[1]);
+
+    // a plain write replaces the whole screen, O_TRUNC blanks the panel before it
+    flags = (choice == LCD_WRITE || choice == SYNC_WRITE) ? (O_WRONLY | O_TRUNC) : O_WRONLY;
+    fd = open("/dev/bbb_lcd0", flags);
     if (fd < 0)
     {
         perror("open() is failed\n");
@@ -20,8 +36,6 @@ int main(int argc, void *argv[])
 
     memset(buf, '\0', BUF_SIZE);
 
-    choice = atoi(argv[1]);
-
     switch (choice)
     {
     case LCD_CLEAR:
@@ -63,12 +77,246 @@ int main(int argc, void *argv[])
         }
         printf("ioctl : lcd shift right is exeucted\n");
         break;
+    case LCD_WRITE_AT:
+        // file offset of a cell is row * NUM_CHARS_PER_LINE + col
+        offset = atoi(argv[2]) * NUM_CHARS_PER_LINE + atoi(argv[3]);
+        len = strlen(argv[4]);
+        ret = pwrite(fd, argv[4], len, offset);
+        if (ret < 0)
+        {
+            perror("pwrite() failed\n");
+        }
+        printf("no. of bytes send %d at cell %ld, string=%s\n", ret, (long)offset, argv[4]);
+        break;
+    case SET_MODE:
+        ret = ioctl(fd, LCD_SET_MODE, atoi(argv[2]));
+        if (ret != 0)
+        {
+            perror("Lcd set mode is failed\n");
+            return ret;
+        }
+        printf("ioctl : lcd mode set to %s\n", atoi(argv[2]) == LCD_MODE_TERMINAL ? "terminal" :
+               atoi(argv[2]) == LCD_MODE_PAGING ? "paging" : "cells");
+        break;
+    case PAGE_FLIP:
+        ret = ioctl(fd, LCD_SET_PAGE_FLIP, atoi(argv[2]));
+        if (ret != 0)
+        {
+            perror("Lcd page flip is failed\n");
+            return ret;
+        }
+        printf("ioctl : lcd page flip %s\n", atoi(argv[2]) ? "on" : "off");
+        break;
+    case SET_POLICY:
+        ret = ioctl(fd, LCD_SET_POLICY, atoi(argv[2]));
+        if (ret != 0)
+        {
+            perror("Lcd set policy is failed\n");
+            return ret;
+        }
+        printf("ioctl : lcd screen selection policy set to %d\n", atoi(argv[2]));
+        break;
+    case SHOW_SCREEN:
+        ret = ioctl(fd, LCD_SHOW_SCREEN, atoi(argv[2]));
+        if (ret != 0)
+        {
+            perror("Lcd show screen is failed\n");
+            return ret;
+        }
+        printf("ioctl : lcd screen %d is shown\n", atoi(argv[2]));
+        break;
+    case SET_REGION:
+        region.row = atoi(argv[2]);
+        region.col = atoi(argv[3]);
+        region.width = atoi(argv[4]);
+        region.height = atoi(argv[5]);
+        ret = ioctl(fd, LCD_SET_REGION, &region);
+        if (ret != 0)
+        {
+            perror("Lcd set region is failed\n");
+            return ret;
+        }
+        len = strlen(argv[6]);
+        ret = write(fd, argv[6], len);
+        if (ret < 0)
+        {
+            perror("write() failed\n");
+        }
+        // the lease ends with close(), keep it until enter is pressed
+        printf("region %ux%u at %u,%u holds %s, press enter to release\n", region.width, region.height,
+               region.row, region.col, argv[6]);
+        getchar();
+        break;
+    case GET_SNAPSHOT:
+        ret = ioctl(fd, LCD_GET_SNAPSHOT, &snap);
+        if (ret != 0)
+        {
+            perror("Lcd snapshot is failed\n");
+            return ret;
+        }
+        printf("frame %u\n[%.*s]\n[%.*s]\n", snap.seq, NUM_CHARS_PER_LINE, snap.cells,
+               NUM_CHARS_PER_LINE, snap.cells + NUM_CHARS_PER_LINE);
+        break;
+    case SYNC_WRITE:
+        // fsync() returns once the text is on the lcd, no need to sleep after the write
+        len = strlen(argv[2]);
+        ret = write(fd, argv[2], len);
+        if (ret < 0 || fsync(fd) != 0 || ioctl(fd, LCD_GET_SEQ, &seq) != 0)
+        {
+            perror("synchronous write failed\n");
+            return 1;
+        }
+        printf("no. of bytes send %d, on the lcd as frame %u\n", ret, seq.shown);
+        break;
+    case ADD_WIDGET:
+        memset(&widget, 0, sizeof(widget));
+        widget.win.row = atoi(argv[2]);
+        widget.win.col = atoi(argv[3]);
+        widget.win.width = atoi(argv[4]);
+        widget.win.height = 1;
+        widget.type = atoi(argv[5]);
+        if (widget.type == LCD_WIDGET_FILE && argc > 6)
+            strncpy(widget.path, argv[6], LCD_WIDGET_PATH - 1);
+        ret = ioctl(fd, LCD_ADD_WIDGET, &widget);
+        if (ret < 0)
+        {
+            perror("Lcd add widget is failed\n");
+            return ret;
+        }
+        printf("ioctl : widget %d added\n", ret);
+        break;
+    case DEL_WIDGET:
+        ret = ioctl(fd, LCD_DEL_WIDGET, atoi(argv[2]));
+        if (ret != 0)
+        {
+            perror("Lcd delete widget is failed\n");
+            return ret;
+        }
+        printf("ioctl : widget %d deleted\n", atoi(argv[2]));
+        break;
+    case BUS_STATS:
+        ret = ioctl(fd, LCD_GET_BUS_STATS, &stats);
+        if (ret != 0)
+        {
+            perror("Lcd bus stats is failed\n");
+            return ret;
+        }
+        printf("command nibbles %llu, data nibbles %llu, bus time %llu us\n",
+               stats.cmd_nibbles, stats.data_nibbles, stats.bus_us);
+        printf("repaired cells %llu, resyncs %llu\n", stats.repaired_cells, stats.resyncs);
+        break;
+    case CALIBRATE:
+        ret = ioctl(fd, LCD_CALIBRATE, &timing);
+        if (ret != 0)
+        {
+            perror("Lcd calibrate is failed\n");
+            return ret;
+        }
+        printf("busy after a command %u us, after data %u us, after return home %u us\n",
+               timing.cmd_us, timing.data_us, timing.home_us);
+        break;
+    case PAGE_WRITE:
+        ret = ioctl(fd, LCD_SET_MODE, LCD_MODE_PAGING);
+        if (ret != 0)
+        {
+            perror("Lcd set mode is failed\n");
+            return ret;
+        }
+        len = strlen(argv[2]);
+        ret = write(fd, argv[2], len);
+        if (ret < 0)
+        {
+            perror("write() failed\n");
+        }
+        // the pages go with the screen on close(), keep them until enter is pressed
+        printf("paging %d bytes, press enter to stop\n", len);
+        getchar();
+        break;
+    case SET_MIRROR:
+        ret = ioctl(fd, LCD_SET_MIRROR, atoi(argv[2]));
+        if (ret != 0)
+        {
+            perror("Lcd set mirror is failed\n");
+            return ret;
+        }
+        printf("ioctl : lcd mirror group set to %d\n", atoi(argv[2]));
+        break;
+    case ANIMATION:
+        // spinner in the last cell of the first row, 4 steps of 150 ms over and over
+        for (i = 0; i < 4; i++)
+        {
+            frames[i].ms = 150;
+            frames[i].first = NUM_CHARS_PER_LINE - 1;
+            frames[i].len = 1;
+            frames[i].cells[0] = "|/-\\"[i];
+        }
+        anim.nframes = 4;
+        anim.loop = 1;
+        anim.frames = frames;
+        ret = ioctl(fd, LCD_SET_ANIMATION, &anim);
+        if (ret != 0)
+        {
+            perror("Lcd set animation is failed\n");
+            return ret;
+        }
+        // the animation goes with the screen on close(), keep it until enter is pressed
+        printf("spinner is running, press enter to stop\n");
+        getchar();
+        break;
+    case WRITE_ROWS:
+        // one buffer per row, both rows are replaced in one call
+        iov[0].iov_base = argv[2];
+        iov[0].iov_len = strlen(argv[2]);
+        iov[1].iov_base = argv[3];
+        iov[1].iov_len = strlen(argv[3]);
+        ret = writev(fd, iov, 2);
+        if (ret < 0)
+        {
+            perror("writev() failed\n");
+            return ret;
+        }
+        printf("rows written with writev()\n");
+        break;
+    case TTL_WRITE:
+        // a message that preempts lower priorities and goes away again after ttl_ms
+        if (ioctl(fd, LCD_SET_PRIORITY, atoi(argv[2])) != 0 || ioctl(fd, LCD_SET_TTL, atoi(argv[3])) != 0)
+        {
+            perror("Lcd set priority/ttl is failed\n");
+            return -1;
+        }
+        len = strlen(argv[4]);
+        ret = write(fd, argv[4], len);
+        if (ret < 0)
+        {
+            perror("write() failed\n");
+        }
+        // the message goes with the screen on close(), keep it until enter is pressed
+        printf("message with priority %d for %d ms, press enter to close\n", atoi(argv[2]), atoi(argv[3]));
+        getchar();
+        break;
     default:
         printf("Invalid command is given. Below is right way of providing command for lcd is shown\n");
         printf("sudo ./a.out 0 <====== lcd clear\n");
         printf("sudo ./a.out 1 data_for_lcd <====== lcd_write\n");
         printf("sudo ./a.out 2 number_of_left_shift <====== lcd_left_shift\n");
         printf("sudo ./a.out 3 number_of_right_shift <====== lcd_right_shift\n");
+        printf("sudo ./a.out 4 row col data_for_lcd <====== lcd_write at row/col\n");
+        printf("sudo ./a.out 5 0|1|2 <====== lcd mode cells/terminal/paging\n");
+        printf("sudo ./a.out 6 0|1 <====== lcd page flip off/on\n");
+        printf("sudo ./a.out 7 0|1|2|3 <====== screen policy latest/manual/round robin/priority\n");
+        printf("sudo ./a.out 8 screen_id <====== show screen\n");
+        printf("sudo ./a.out 9 row col width height data_for_lcd <====== lease region and write into it\n");
+        printf("sudo ./a.out 10 <====== show what the lcd displays\n");
+        printf("sudo ./a.out 11 data_for_lcd <====== lcd_write and wait until it is shown\n");
+        printf("sudo ./a.out 12 row col width 0|1|2|3 [path] <====== widget clock/uptime/loadavg/file\n");
+        printf("sudo ./a.out 13 widget_id <====== delete widget\n");
+        printf("sudo ./a.out 14 <====== bus nibbles and time so far\n");
+        printf("sudo ./a.out 15 long_message <====== show a long message page by page\n");
+        printf("sudo ./a.out 16 group <====== mirror group of the lcd, 0 for none\n");
+        printf("sudo ./a.out 17 <====== spinner animation played by the driver\n");
+        printf("sudo ./a.out 18 first_row second_row <====== both rows in one writev()\n");
+        printf("sudo ./a.out 19 priority ttl_ms data_for_lcd <====== message that expires\n");
+        printf("sudo ./a.out 20 <====== measure the panel timing, needs rw_wired=1\n");
         break;
     }
 
@@ -10,11 +10,18 @@ struct ioctl_msg{
     unsigned int shift;
 };
 
+// what the lcd shows, LCD_GET_SNAPSHOT
+struct lcd_snapshot{
+    unsigned int seq;       // changes whenever the text on the lcd changes
+    char cells[BUF_SIZE];   // row by row, NUM_CHARS_PER_LINE cells per row
+};
+
 #define LCD_CLEAR_IOCTL _IOW('x',1, struct ioctl_msg)
 #define LCD_SHIFT_LEFT  _IOW('x',2,int) 
 #define LCD_SHIFT_RIGHT _IOW('x',3,int)  
 #define LCD_PRINT_ON_FIRST_LINE _IOW('x',4,struct ioctl_msg)
 #define LCD_PRINT_ON_SECOND_LINE _IOW('x',5,struct ioctl_msg)
+#define LCD_GET_SNAPSHOT _IOR('x',6,struct lcd_snapshot)
 
 #define LCD_CLEAR               0 
 #define LCD_WRITE               1
@@ -22,5 +29,6 @@ struct ioctl_msg{
 #define SHIFT_RIGHT             3
 #define PRINT_ON_FIRST_LINE     4
 #define PRINT_ON_SECOND_LINE    5    
+#define GET_SNAPSHOT            6
 
 #endif
\ No newline at end of file
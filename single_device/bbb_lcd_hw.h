@@ -0,0 +1,25 @@
+#ifndef __BBB_LCD_HW
+#define __BBB_LCD_HW
+
+// no kernel types in here, user_driver drives the same wiring from userspace
+
+#define LCD_RS   67  // P8_8
+#define LCD_EN   44  // P8_12
+#define LCD_D4   26  // P8_14
+#define LCD_D5   46  // P8_16
+#define LCD_D6   65  // P8_18
+#define LCD_D7   61  // P8_26
+
+#define LCD_LINE_NUM_ONE    1
+#define LCD_LINE_NUM_TWO    2
+#define LCD_LINE1_ADD 		0x80
+#define LCD_LINE2_ADD 		0xC0
+#define NUM_CHARS_PER_LINE  16
+#define NUM_LINES           2
+#define LCD_CELLS           (NUM_LINES * NUM_CHARS_PER_LINE)
+
+#define LCD_CMD		    0
+#define LCD_DATA	    1
+#define BUF_SIZE       32
+
+#endif
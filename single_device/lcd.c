@@ -6,6 +6,9 @@
 #include <linux/init.h>
 #include <linux/gpio.h> 
 #include <linux/delay.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
 #include "bbb_ioctl.h"
 #include "bbb_lcd.h"
 
@@ -15,6 +18,8 @@ static struct file_operations f_ops = {
     .release = lcd_close,
     .read = lcd_read,
     .write = lcd_write,
+    .poll = lcd_poll,
+    .fsync = lcd_fsync,
     .unlocked_ioctl = lcd_ioctl
 };
 
@@ -31,7 +36,12 @@ static dev_t devno;
 static struct cdev cdev;
 static struct class *pclass;
 static int major;
-static char kbuf[BUF_SIZE];
+static char kbuf[LCD_CELLS + 1]; // a whole screen and the terminating NULL
+static DEFINE_MUTEX(kbuf_lock); // kbuf is shared by every writer of the device, also serializes the lcd and screen
+static char screen[LCD_CELLS];  // what the lcd shows, kept as the text is sent since the lcd is never read back
+static unsigned int screen_line, screen_col; // where the lcd address counter points
+static unsigned int screen_seq; // bumped on every change of screen
+static DECLARE_WAIT_QUEUE_HEAD(screen_wq); // woken when screen_seq changes
 
 static __init int lcd_init(void)
 {
@@ -84,6 +94,7 @@ static __init int lcd_init(void)
         goto lcd_all_pin_init_failed;
     }
     //initializing the lcd
+    memset(screen, ' ', LCD_CELLS);
     lcd_initialize();
     printk(KERN_INFO "%s : Lcd_init() success \n", THIS_MODULE->name);
 
@@ -119,6 +130,8 @@ static __exit void lcd_exit(void)
 int lcd_open(struct inode *pinode, struct file *pfile)
 {
     printk(KERN_INFO "%s : lcd_open is called\n", THIS_MODULE->name);
+    // private_data holds the screen_seq this file has seen, for poll()
+    pfile->private_data = (void *)(unsigned long)READ_ONCE(screen_seq);
     return 0;
 }
 int lcd_close(struct inode *pinode, struct file *pfile)
@@ -126,26 +139,69 @@ int lcd_close(struct inode *pinode, struct file *pfile)
     printk(KERN_INFO "%s : lcd_close is called\n", THIS_MODULE->name);
     return 0;
 }
-ssize_t lcd_read(struct file *pfile, char *ubuf, size_t size, loff_t *poffset)
+ssize_t lcd_read(struct file *pfile, char __user *ubuf, size_t size, loff_t *poffset)
 {
-    // You can't read the data from the lcd so this function is not implemented
+    size_t len;
+    loff_t pos = *poffset;
     printk(KERN_INFO "%s : lcd_read is called\n", THIS_MODULE->name);
-    return size;
+
+    // the lcd can't be read, the text comes from screen, one byte per cell row by row
+    if (pos < 0)
+        return -EINVAL;
+    if (pos >= LCD_CELLS)
+        return 0;
+    len = min_t(size_t, size, LCD_CELLS - pos);
+
+    mutex_lock(&kbuf_lock);
+    if (copy_to_user(ubuf, screen + pos, len) != 0)
+    {
+        mutex_unlock(&kbuf_lock);
+        return -EFAULT;
+    }
+    pfile->private_data = (void *)(unsigned long)screen_seq;
+    mutex_unlock(&kbuf_lock);
+
+    *poffset = pos + len;
+    return len;
+}
+
+// readable when the text changed since this file last read it
+static __poll_t lcd_poll(struct file *pfile, struct poll_table_struct *wait)
+{
+    poll_wait(pfile, &screen_wq, wait);
+    if (READ_ONCE(screen_seq) != (unsigned int)(unsigned long)pfile->private_data)
+        return EPOLLIN | EPOLLRDNORM;
+    return 0;
+}
+
+// write() and the ioctls return after the lcd has the text, there is nothing left to wait for
+static int lcd_fsync(struct file *pfile, loff_t start, loff_t end, int datasync)
+{
+    return 0;
 }
 ssize_t lcd_write(struct file *pfile, const char __user *ubuf, size_t size, loff_t *poffset)
 {
     int ret;
+    size_t len;
     printk(KERN_INFO "%s : lcd_write is called\n", THIS_MODULE->name);
-    memset(kbuf,'\0',sizeof(kbuf)); // initializing kernel space buffer to NULL.
-    ret = copy_from_user(&kbuf, ubuf, size); // coping the data from user space buffer(ubuf) to kernle space buffer(kbuf)
+
+    // a whole screen fits next to the terminating NULL, anything longer than the lcd is dropped
+    len = min_t(size_t, size, LCD_CELLS);
+
+    mutex_lock(&kbuf_lock);
+    ret = copy_from_user(kbuf, ubuf, len); // coping the data from user space buffer(ubuf) to kernle space buffer(kbuf)
     if (ret != 0)
     {
+        mutex_unlock(&kbuf_lock);
         printk(KERN_ERR "%s : bytes not copied from user buffer %d\n", THIS_MODULE->name, ret);
+        return -EFAULT;
     }
-    
-    lcd_clearDisplay(); // before sending data on to lcd clearing the exist data
+    kbuf[len] = '\0';
+
+    lcd_clear_display(); // before sending data on to lcd clearing the exist data
 
     lcd_print(kbuf,LCD_LINE_NUM_ONE); // calling lcd_print() function for sending data to lcd
+    mutex_unlock(&kbuf_lock);
     printk(KERN_INFO "%s : lcd data write\n", THIS_MODULE->name);
     return size;
 }
@@ -154,6 +210,7 @@ static long lcd_ioctl(struct file *pfile, unsigned cmd, unsigned long param){
 
     unsigned int i, ret;
     struct ioctl_msg msg;
+    struct lcd_snapshot snap;
     printk(KERN_INFO"%s : lcd_ioctl() is called\n", THIS_MODULE->name);
     
     // checking if parameter is provided or not
@@ -162,6 +219,17 @@ static long lcd_ioctl(struct file *pfile, unsigned cmd, unsigned long param){
         return -EINVAL;
     }
 
+    // the only command that hands data back, param points at a struct lcd_snapshot
+    if (cmd == LCD_GET_SNAPSHOT)
+    {
+        mutex_lock(&kbuf_lock);
+        snap.seq = screen_seq;
+        memcpy(snap.cells, screen, LCD_CELLS);
+        pfile->private_data = (void *)(unsigned long)screen_seq;
+        mutex_unlock(&kbuf_lock);
+        return copy_to_user((void __user *)param, &snap, sizeof(snap)) ? -EFAULT : 0;
+    }
+
     memset(&msg, '\0', sizeof(struct ioctl_msg));// initializing all member of structure to NULL.
 
     ret = copy_from_user(&msg, (void*)param, sizeof(struct ioctl_msg));// coping data into kernel space struct ioctl_msg
@@ -171,10 +239,14 @@ static long lcd_ioctl(struct file *pfile, unsigned cmd, unsigned long param){
         return -EINVAL;
     }
 
+    mutex_lock(&kbuf_lock);
+    // msg.buf may use all BUF_SIZE bytes, lcd_print() walks kbuf up to the NULL after them
+    memcpy(kbuf, msg.buf, BUF_SIZE);
+    kbuf[BUF_SIZE] = '\0';
     switch (cmd)
     {
     case LCD_CLEAR_IOCTL:
-        lcd_clearDisplay();
+        lcd_clear_display();
         printk(KERN_INFO "lcd_ioctl : lcd_clear is called\n");
         break;
     case LCD_SHIFT_LEFT:
@@ -196,18 +268,20 @@ static long lcd_ioctl(struct file *pfile, unsigned cmd, unsigned long param){
         }
         break;
     case LCD_PRINT_ON_FIRST_LINE:
-        lcd_print(msg.buf,msg.line_number);
+        lcd_print(kbuf,msg.line_number);
         printk(KERN_INFO"%s : print data on first line of lcd\n",THIS_MODULE->name);
         break;
     case LCD_PRINT_ON_SECOND_LINE:
-        lcd_print(msg.buf,msg.line_number);
+        lcd_print(kbuf,msg.line_number);
         printk(KERN_INFO"%s : print data on second line of lcd\n",THIS_MODULE->name);
         break;
     default:
+        mutex_unlock(&kbuf_lock);
         printk(KERN_INFO"%s : Invaild cmd\n", THIS_MODULE->name);
         return -EINVAL;
         break;
     }
+    mutex_unlock(&kbuf_lock);
     return 0;
 }
 
@@ -358,6 +432,11 @@ static void lcd_data(char data)
     gpio_set_value(LCD_EN, 1);
     usleep_range(5, 10);
     gpio_set_value(LCD_EN, 0);
+
+    // keeping screen in step, characters past the end of the line land in hidden DDRAM
+    if (screen_col < NUM_CHARS_PER_LINE)
+        screen[screen_line * NUM_CHARS_PER_LINE + screen_col] = data;
+    screen_col++;
 }
 
 static void lcd_initialize()
@@ -418,7 +497,7 @@ static void lcd_initialize()
 
 static void lcd_print(char *msg, unsigned int lineNumber)
 {
-	unsigned int counter = 1;
+	unsigned int counter = 0;
 	unsigned int lineNum = lineNumber;
 
 	if(msg == NULL){
@@ -433,7 +512,7 @@ static void lcd_print(char *msg, unsigned int lineNumber)
 
 	if( lineNum == 1 )
 	{
-		lcd_setLinePosition( LCD_LINE_NUM_ONE );
+		lcd_set_line_position( LCD_LINE_NUM_ONE );
 		while( *(msg) != '\0' )
 		{
 			if(counter >=  NUM_CHARS_PER_LINE )
@@ -450,7 +529,7 @@ static void lcd_print(char *msg, unsigned int lineNumber)
 
 	if( lineNum == 2)
 	{
-		lcd_setLinePosition( LCD_LINE_NUM_TWO);
+		lcd_set_line_position( LCD_LINE_NUM_TWO);
 		while( *(msg) != '\0' )
 		{
 			if(counter >=  NUM_CHARS_PER_LINE )
@@ -462,6 +541,13 @@ static void lcd_print(char *msg, unsigned int lineNumber)
 			counter++;
 		}
 	}
+	lcd_screen_changed();
+}
+
+static void lcd_screen_changed(void)
+{
+	screen_seq++;
+	wake_up_interruptible_all(&screen_wq);
 }
 
 static void lcd_set_line_position(unsigned int line)
@@ -469,10 +555,14 @@ static void lcd_set_line_position(unsigned int line)
 	if(line == 1){ // set position to LCD line 1
 		lcd_instruction(0x80);	
 		lcd_instruction(0x00);
+		screen_line = 0;
+		screen_col = 0;
 	}
 	else if(line == 2){ // set position to LCD line 2
 		lcd_instruction(0xC0);  
 		lcd_instruction(0x00);
+		screen_line = 1;
+		screen_col = 0;
 	}
 	else{
 		printk(KERN_INFO"Invalid line number\n");
@@ -483,6 +573,10 @@ static void lcd_clear_display()
 {   // lcd clear instruction
 	lcd_instruction( 0x00 ); 
 	lcd_instruction( 0x10 ); 
+	memset(screen, ' ', LCD_CELLS);
+	screen_line = 0;
+	screen_col = 0;
+	lcd_screen_changed();
 	printk(KERN_INFO"%s : display clear\n",THIS_MODULE->name);
 }
 
@@ -12,6 +12,7 @@ int main(int argc, void *argv[])
     int choice, len, fd, ret;
     char buf[32];
     struct ioctl_msg msg;
+    struct lcd_snapshot snap;
 
     fd = open("/dev/bbb_lcd0", O_WRONLY);
     if (fd < 0)
@@ -86,6 +87,16 @@ int main(int argc, void *argv[])
         }
         printf("ioctl : print on second line of lcd is exeucted\n");
         break;
+    case GET_SNAPSHOT:
+        ret = ioctl(fd, LCD_GET_SNAPSHOT, &snap);
+        if (ret != 0)
+        {
+            perror("lcd snapshot failed\n");
+            return ret;
+        }
+        printf("screen %u\n[%.*s]\n[%.*s]\n", snap.seq, NUM_CHARS_PER_LINE, snap.cells,
+               NUM_CHARS_PER_LINE, snap.cells + NUM_CHARS_PER_LINE);
+        break;
     default:
         printf("Invalid command is given. Below is right way of providing command for lcd is shown\n");
         printf("sudo ./a.out 0 <====== lcd clear\n");
@@ -94,6 +105,7 @@ int main(int argc, void *argv[])
         printf("sudo ./a.out 3 number_of_right_shift <====== lcd_right_shift\n");
         printf("sudo ./a.out 4 data_for_print_on_first_line <====== print_on_first_line\n");
         printf("sudo ./a.out 5 data_for_print_on_second_line <====== print_on_second_line\n");
+        printf("sudo ./a.out 6 <====== show what the lcd displays\n");
         break;
     }
 
@@ -0,0 +1,24 @@
+#!/bin/sh
+# create (up) or remove (down) a gpio-sim chip with the six lcd lines, for running lcd_user_test
+# on any linux host: sudo ./gpio_sim.sh up && sudo ./lcd_user_test -c /dev/<chip> 1 hello
+# needs CONFIG_GPIO_SIM and configfs mounted on /sys/kernel/config
+
+SIM=/sys/kernel/config/gpio-sim/bbb_lcd
+
+case "$1" in
+up)
+    modprobe gpio-sim 2>/dev/null
+    mkdir -p $SIM/bank0 || exit 1
+    echo 6 > $SIM/bank0/num_lines
+    echo 1 > $SIM/live
+    echo "/dev/$(cat $SIM/bank0/chip_name)"
+    ;;
+down)
+    echo 0 > $SIM/live
+    rmdir $SIM/bank0 $SIM
+    ;;
+*)
+    echo "usage: $0 up|down"
+    exit 1
+    ;;
+esac
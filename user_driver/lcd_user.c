@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include "bbb_lcd_hw.h"
+#include "lcd_user.h"
+
+// index of each line in lcd_user_pin[], the same order as lcd_pin[] of the module
+#define LINE_RS     0
+#define LINE_EN     1
+#define LINE_D4     2
+
+#define LCD_USER_CHIP_PATH  32
+
+// HD44780 timings in ns, the module sleeps 2-3 ms before every nibble instead
+#define T_SETUP_NS      1000        // RS/data to EN rising, datasheet 40 ns
+#define T_PULSE_NS      1000        // EN high, datasheet 230 ns
+#define T_EXEC_NS       50000       // most instructions, datasheet 37 us
+#define T_EXEC_LONG_NS  2000000     // clear display and return home, datasheet 1.52 ms
+
+// lines of one gpiochip, requested together
+struct lcd_user_group
+{
+    int fd;                         // line request fd
+    unsigned int first;             // first line of the group, names its chip
+};
+
+struct lcd_user
+{
+    struct lcd_user_group group[LCD_USER_LINES];
+    unsigned int ngroups;
+    unsigned int line_group[LCD_USER_LINES];    // group of each line
+    unsigned int line_bit[LCD_USER_LINES];      // index of each line inside its group request
+    struct timespec ready;                      // the controller is done with the last instruction
+};
+
+void lcd_user_default_pins(struct lcd_user_pin pins[LCD_USER_LINES])
+{
+    static char path[LCD_USER_LINES][LCD_USER_CHIP_PATH];
+    static const int gpio[LCD_USER_LINES] = {LCD_RS, LCD_EN, LCD_D4, LCD_D5, LCD_D6, LCD_D7};
+    int i;
+
+    for (i = 0; i < LCD_USER_LINES; i++)
+    {
+        snprintf(path[i], sizeof(path[i]), "/dev/gpiochip%d", gpio[i] / 32);
+        pins[i].chip = path[i];
+        pins[i].offset = gpio[i] % 32;
+    }
+}
+
+static void lcd_user_add_ns(struct timespec *t, long ns)
+{
+    t->tv_nsec += ns;
+    while (t->tv_nsec >= 1000000000)
+    {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000;
+    }
+}
+
+// sleep for 'ns' from now
+static void lcd_user_delay(long ns)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    lcd_user_add_ns(&t, ns);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR)
+        ;
+}
+
+// drive the lines in 'which' to the levels in 'values', one SET_VALUES per chip that has any of them
+static int lcd_user_set(struct lcd_user *lcd, unsigned int which, unsigned int values)
+{
+    struct gpio_v2_line_values v[LCD_USER_LINES];
+    unsigned int i, g;
+
+    memset(v, 0, sizeof(v));
+    for (i = 0; i < LCD_USER_LINES; i++)
+    {
+        if (!(which & (1u << i)))
+            continue;
+        g = lcd->line_group[i];
+        v[g].mask |= 1ull << lcd->line_bit[i];
+        if (values & (1u << i))
+            v[g].bits |= 1ull << lcd->line_bit[i];
+    }
+    for (g = 0; g < lcd->ngroups; g++)
+    {
+        if (v[g].mask != 0 && ioctl(lcd->group[g].fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &v[g]) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/*
+ * description:		put one nibble on D7..D4 with RS and clock it in on the falling edge of EN.
+ *			Waits until the controller is done with the previous instruction first, then
+ *			marks it busy for 'exec_ns'.
+ */
+static int lcd_user_nibble(struct lcd_user *lcd, unsigned char nib, int rs, long exec_ns)
+{
+    unsigned int values = (nib & 0xF) << LINE_D4;
+    unsigned int bus = (0xFu << LINE_D4) | (1u << LINE_RS);
+
+    if (rs == LCD_DATA)
+        values |= 1u << LINE_RS;
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &lcd->ready, NULL) == EINTR)
+        ;
+    if (lcd_user_set(lcd, bus, values) < 0)
+        return -1;
+    lcd_user_delay(T_SETUP_NS);
+    if (lcd_user_set(lcd, 1u << LINE_EN, 1u << LINE_EN) < 0)
+        return -1;
+    lcd_user_delay(T_PULSE_NS);
+    if (lcd_user_set(lcd, 1u << LINE_EN, 0) < 0)
+        return -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &lcd->ready);
+    lcd_user_add_ns(&lcd->ready, exec_ns);
+    return 0;
+}
+
+// a whole byte in two nibbles, the controller executes it after the second one
+static int lcd_user_byte(struct lcd_user *lcd, unsigned char byte, int rs, long exec_ns)
+{
+    if (lcd_user_nibble(lcd, byte >> 4, rs, 0) < 0)
+        return -1;
+    return lcd_user_nibble(lcd, byte & 0xF, rs, exec_ns);
+}
+
+static int lcd_user_command(struct lcd_user *lcd, unsigned char cmd)
+{
+    // clear display (0x01) and return home (0x02/0x03) take the long time
+    return lcd_user_byte(lcd, cmd, LCD_CMD, cmd <= 0x03 ? T_EXEC_LONG_NS : T_EXEC_NS);
+}
+
+// the lcd_initialize() sequence of the module
+static int lcd_user_initialize(struct lcd_user *lcd)
+{
+    int ret = 0;
+
+    lcd_user_delay(41 * 1000000L);                          // > 40 ms after power on
+    ret |= lcd_user_nibble(lcd, 0x3, LCD_CMD, 5 * 1000000L); // 8 bit mode, > 4.1 ms
+    ret |= lcd_user_nibble(lcd, 0x3, LCD_CMD, 200000);       // > 100 us
+    ret |= lcd_user_nibble(lcd, 0x3, LCD_CMD, 200000);
+    ret |= lcd_user_nibble(lcd, 0x2, LCD_CMD, 200000);       // 4 bit mode
+    ret |= lcd_user_command(lcd, 0x28);                      // 2 lines, 5x8 font
+    ret |= lcd_user_command(lcd, 0x08);                      // display off
+    ret |= lcd_user_command(lcd, 0x01);                      // clear
+    ret |= lcd_user_command(lcd, 0x06);                      // cursor moves right, no display shift
+    ret |= lcd_user_command(lcd, 0x0F);                      // display, cursor and blinking on
+    return ret ? -1 : 0;
+}
+
+struct lcd_user *lcd_user_open(const struct lcd_user_pin pins[LCD_USER_LINES])
+{
+    struct gpio_v2_line_request req[LCD_USER_LINES];
+    struct lcd_user *lcd;
+    unsigned int i, g;
+    int chip, saved;
+
+    lcd = calloc(1, sizeof(*lcd));
+    if (lcd == NULL)
+        return NULL;
+
+    // group the lines by chip, in the order the chips first appear
+    memset(req, 0, sizeof(req));
+    for (i = 0; i < LCD_USER_LINES; i++)
+    {
+        for (g = 0; g < lcd->ngroups; g++)
+        {
+            if (strcmp(pins[lcd->group[g].first].chip, pins[i].chip) == 0)
+                break;
+        }
+        if (g == lcd->ngroups)
+        {
+            lcd->group[g].first = i;
+            lcd->group[g].fd = -1;
+            lcd->ngroups++;
+        }
+        lcd->line_group[i] = g;
+        lcd->line_bit[i] = req[g].num_lines;
+        req[g].offsets[req[g].num_lines++] = pins[i].offset;
+    }
+
+    for (g = 0; g < lcd->ngroups; g++)
+    {
+        chip = open(pins[lcd->group[g].first].chip, O_RDWR | O_CLOEXEC);
+        if (chip < 0)
+            goto request_failed;
+
+        strcpy(req[g].consumer, "bbb_lcd");
+        req[g].config.flags = GPIO_V2_LINE_FLAG_OUTPUT;     // all low until the first nibble
+        if (ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &req[g]) < 0)
+        {
+            saved = errno;
+            close(chip);
+            errno = saved;
+            goto request_failed;
+        }
+        close(chip);    // the request keeps its own fd
+        lcd->group[g].fd = req[g].fd;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &lcd->ready);
+    if (lcd_user_initialize(lcd) < 0)
+        goto request_failed;
+    return lcd;
+
+request_failed:
+    saved = errno;
+    lcd_user_close(lcd);
+    errno = saved;
+    return NULL;
+}
+
+void lcd_user_close(struct lcd_user *lcd)
+{
+    unsigned int g;
+
+    if (lcd == NULL)
+        return;
+    for (g = 0; g < lcd->ngroups; g++)
+    {
+        if (lcd->group[g].fd >= 0)
+            close(lcd->group[g].fd);
+    }
+    free(lcd);
+}
+
+int lcd_user_clear(struct lcd_user *lcd)
+{
+    return lcd_user_command(lcd, 0x01);
+}
+
+// print up to NUM_CHARS_PER_LINE characters of 'msg' from the start of 'line', returns the number printed
+static int lcd_user_line(struct lcd_user *lcd, const char *msg, unsigned int len, unsigned int line)
+{
+    unsigned int i;
+
+    if (lcd_user_command(lcd, line == LCD_LINE_NUM_TWO ? LCD_LINE2_ADD : LCD_LINE1_ADD) < 0)
+        return -1;
+    for (i = 0; i < len && i < NUM_CHARS_PER_LINE && msg[i] != '\0'; i++)
+    {
+        if (lcd_user_byte(lcd, msg[i], LCD_DATA, T_EXEC_NS) < 0)
+            return -1;
+    }
+    return i;
+}
+
+int lcd_user_print(struct lcd_user *lcd, const char *msg, unsigned int line)
+{
+    // the module readjusts an invalid line number to line one
+    if (line != LCD_LINE_NUM_TWO)
+        line = LCD_LINE_NUM_ONE;
+    return lcd_user_line(lcd, msg, strlen(msg), line) < 0 ? -1 : 0;
+}
+
+int lcd_user_write(struct lcd_user *lcd, const char *buf, unsigned int len)
+{
+    int n;
+
+    if (lcd_user_clear(lcd) < 0)
+        return -1;
+    n = lcd_user_line(lcd, buf, len, LCD_LINE_NUM_ONE);
+    if (n < 0)
+        return -1;
+    if (n == NUM_CHARS_PER_LINE && len > (unsigned int)n)
+        n = lcd_user_line(lcd, buf + n, len - n, LCD_LINE_NUM_TWO);
+    return n < 0 ? -1 : 0;
+}
+
+int lcd_user_shift_left(struct lcd_user *lcd, unsigned int shift)
+{
+    while (shift-- > 0)
+    {
+        if (lcd_user_command(lcd, 0x18) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+int lcd_user_shift_right(struct lcd_user *lcd, unsigned int shift)
+{
+    while (shift-- > 0)
+    {
+        if (lcd_user_command(lcd, 0x1C) < 0)
+            return -1;
+    }
+    return 0;
+}
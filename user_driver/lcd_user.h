@@ -0,0 +1,40 @@
+#ifndef __LCD_USER
+#define __LCD_USER
+
+/*
+ * lcd_user : the single_device lcd.c protocol driven from userspace through the gpio character
+ * device (v2 uAPI), for boards where the module can't be loaded.
+ *
+ * The lines are grouped by gpiochip and each group is requested once, so on a board that has all
+ * six lines on one chip (or a gpio-sim mock) RS and D4..D7 change with a single
+ * GPIO_V2_LINE_SET_VALUES_IOCTL. On the BeagleBone the lines are spread over banks 0, 1 and 2,
+ * which makes it one request and one ioctl per bank.
+ *
+ * Every function returns 0 on success and -1 with errno set on failure.
+ */
+
+#define LCD_USER_LINES  6   // RS, EN, D4, D5, D6, D7, the order of lcd_pin[] in lcd.c
+
+struct lcd_user_pin
+{
+    const char *chip;       // e.g. "/dev/gpiochip1"
+    unsigned int offset;    // line offset within the chip
+};
+
+struct lcd_user;
+
+// the BeagleBone wiring of bbb_lcd_hw.h, gpio n is line n % 32 of /dev/gpiochip(n / 32)
+void lcd_user_default_pins(struct lcd_user_pin pins[LCD_USER_LINES]);
+
+struct lcd_user *lcd_user_open(const struct lcd_user_pin pins[LCD_USER_LINES]);
+void lcd_user_close(struct lcd_user *lcd);
+
+// the same as the module: write() clears and prints from line one, wrapping onto line two
+int lcd_user_write(struct lcd_user *lcd, const char *buf, unsigned int len);
+int lcd_user_clear(struct lcd_user *lcd);
+int lcd_user_shift_left(struct lcd_user *lcd, unsigned int shift);
+int lcd_user_shift_right(struct lcd_user *lcd, unsigned int shift);
+// LCD_PRINT_ON_FIRST_LINE / LCD_PRINT_ON_SECOND_LINE, line is 1 or 2
+int lcd_user_print(struct lcd_user *lcd, const char *msg, unsigned int line);
+
+#endif
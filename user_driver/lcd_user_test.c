@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bbb_ioctl.h"
+#include "lcd_user.h"
+
+/*
+ * the lcd_test commands of single_device, run through lcd_user instead of the module.
+ * -c chip -o rs,en,d4,d5,d6,d7 puts all lines on one chip, e.g. the gpio-sim chip of gpio_sim.sh.
+ * The time spent in the command is printed, for comparing against the module.
+ */
+int main(int argc, char *argv[])
+{
+    struct lcd_user_pin pins[LCD_USER_LINES];
+    struct lcd_user *lcd;
+    struct timespec start, end;
+    const char *chip = NULL, *offsets = NULL;
+    char *p;
+    int opt, choice, ret, i;
+
+    while ((opt = getopt(argc, argv, "c:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            chip = optarg;
+            break;
+        case 'o':
+            offsets = optarg;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind >= argc)
+        goto usage;
+
+    lcd_user_default_pins(pins);
+    if (chip != NULL)
+    {
+        for (i = 0; i < LCD_USER_LINES; i++)
+        {
+            pins[i].chip = chip;
+            pins[i].offset = i;
+        }
+    }
+    if (offsets != NULL)
+    {
+        p = (char *)offsets;
+        for (i = 0; i < LCD_USER_LINES && *p != '\0'; i++)
+        {
+            pins[i].offset = strtoul(p, &p, 0);
+            if (*p == ',')
+                p++;
+        }
+    }
+
+    lcd = lcd_user_open(pins);
+    if (lcd == NULL)
+    {
+        perror("lcd_user_open() failed");
+        return 1;
+    }
+
+    choice = atoi(argv[optind]);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    switch (choice)
+    {
+    case LCD_CLEAR:
+        ret = lcd_user_clear(lcd);
+        break;
+    case LCD_WRITE:
+        ret = optind + 1 < argc ? lcd_user_write(lcd, argv[optind + 1], strlen(argv[optind + 1])) : -1;
+        break;
+    case SHIFT_LEFT:
+        ret = optind + 1 < argc ? lcd_user_shift_left(lcd, atoi(argv[optind + 1])) : -1;
+        break;
+    case SHIFT_RIGHT:
+        ret = optind + 1 < argc ? lcd_user_shift_right(lcd, atoi(argv[optind + 1])) : -1;
+        break;
+    case PRINT_ON_FIRST_LINE:
+        ret = optind + 1 < argc ? lcd_user_print(lcd, argv[optind + 1], 1) : -1;
+        break;
+    case PRINT_ON_SECOND_LINE:
+        ret = optind + 1 < argc ? lcd_user_print(lcd, argv[optind + 1], 2) : -1;
+        break;
+    default:
+        lcd_user_close(lcd);
+        goto usage;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    lcd_user_close(lcd);
+
+    if (ret < 0)
+    {
+        perror("lcd command failed");
+        return 1;
+    }
+    printf("command %d took %ld us\n", choice,
+           (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000);
+    return 0;
+
+usage:
+    printf("usage: %s [-c gpiochip] [-o rs,en,d4,d5,d6,d7] command [arg]\n", argv[0]);
+    printf("0 <====== lcd clear\n");
+    printf("1 data_for_lcd <====== lcd_write\n");
+    printf("2 number_of_left_shift <====== lcd_left_shift\n");
+    printf("3 number_of_right_shift <====== lcd_right_shift\n");
+    printf("4 data_for_lcd <====== print on first line\n");
+    printf("5 data_for_lcd <====== print on second line\n");
+    return 1;
+}